@@ -242,6 +242,8 @@ void DebuggerDemo::OnDebugV4()
 		CJSScriptDebuggerFrontend* pDebuggerFrontend = new CJSScriptDebuggerFrontend();
 		QObject::connect(m_pV4Thread->GetDebuggerBackend(), SIGNAL(sendResponse(QVariant)), pDebuggerFrontend, SLOT(processResponse(QVariant)), Qt::QueuedConnection);
 		QObject::connect(pDebuggerFrontend, SIGNAL(sendRequest(QVariant)), m_pV4Thread->GetDebuggerBackend(), SLOT(processRequest(QVariant)), Qt::QueuedConnection);
+		QObject::connect(m_pV4Thread->GetDebuggerBackend(), SIGNAL(newV4EventAvailable(int)), pDebuggerFrontend, SLOT(onEventAvailable(int)), Qt::QueuedConnection);
+		pDebuggerFrontend->setEventPolling(false); // the backend pushes its events
 
 		m_pV4Debugger = new CJSScriptDebugger();
 		connect(m_pV4Debugger, &CJSScriptDebugger::detach, this, [=]() {
@@ -273,6 +275,8 @@ void DebuggerDemo::OnDebugQS()
 		CJSScriptDebuggerFrontend* pDebuggerFrontend = new CJSScriptDebuggerFrontend();
 		QObject::connect(m_pQSThread->GetDebuggerBackend(), SIGNAL(sendResponse(QVariant)), pDebuggerFrontend, SLOT(processResponse(QVariant)), Qt::QueuedConnection);
 		QObject::connect(pDebuggerFrontend, SIGNAL(sendRequest(QVariant)), m_pQSThread->GetDebuggerBackend(), SLOT(processRequest(QVariant)), Qt::QueuedConnection);
+		QObject::connect(m_pQSThread->GetDebuggerBackend(), SIGNAL(newEventAvailable(int)), pDebuggerFrontend, SLOT(onEventAvailable(int)), Qt::QueuedConnection);
+		pDebuggerFrontend->setEventPolling(false); // the backend pushes its events
 
 		m_pQSDebugger = new CJSScriptDebugger();
 		connect(m_pV4Debugger, &CJSScriptDebugger::detach, this, [=]() {
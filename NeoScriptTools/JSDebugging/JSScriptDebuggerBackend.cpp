@@ -86,6 +86,16 @@ QVariant CJSScriptDebuggerBackend::handleRequest(const QVariant& var)
 				out["Event"] = d->pendingEvents.takeFirst();
 			return out;
 		}
+		else if (in["Control"] == "PullEvents") // drains all or up to "Max" events in one go
+		{
+			QVariantMap out;
+			int count = in["Max"].toInt();
+			if (count <= 0 || count > d->pendingEvents.size())
+				count = d->pendingEvents.size();
+			out["Events"] = d->pendingEvents.mid(0, count);
+			d->pendingEvents.erase(d->pendingEvents.begin(), d->pendingEvents.begin() + count);
+			return out;
+		}
 		else if (in["Control"] == "Detach")
 		{
 			detach();
@@ -120,7 +130,9 @@ void CJSScriptDebuggerBackend::processRequest(const QVariant& var)
 
 void CJSScriptDebuggerBackendPrivate::event(const QScriptDebuggerEvent &event)
 {
+	Q_Q(CJSScriptDebuggerBackend);
 	pendingEvents.append(event.toVariant());
+	emit q->newEventAvailable(pendingEvents.size());
 
 	eventStackCounter ++;
 	while(eventStackCounter > 0)
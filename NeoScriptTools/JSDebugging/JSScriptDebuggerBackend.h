@@ -53,6 +53,7 @@ public:
 
 signals:
 	void sendResponse(const QVariant& var);
+	void newEventAvailable(int noOfPendingEvents);
 
 public slots:
 	void processRequest(const QVariant& var);
@@ -30,25 +30,82 @@
 #include "JSScriptDebuggerFrontend.h"
 #include <private/qobject_p.h>
 
+#define EVENT_POLL_INTERVAL		75
+#define MAX_EVENTS_PER_DRAIN	256
+
 class CJSScriptDebuggerFrontendPrivate: public QObjectPrivate
 {
 	Q_DECLARE_PUBLIC(CJSScriptDebuggerFrontend)
 public:
 	
+	void scheduleDrain();
+
 	int eventTimerId;
+	bool drainScheduled;
 };
+
+void CJSScriptDebuggerFrontendPrivate::scheduleDrain()
+{
+	Q_Q(CJSScriptDebuggerFrontend);
+	if (drainScheduled)
+		return;
+	drainScheduled = true;
+	QMetaObject::invokeMethod(q, "drainEvents", Qt::QueuedConnection);
+}
 
 CJSScriptDebuggerFrontend::CJSScriptDebuggerFrontend(QObject *parent)
 	: QObject(*new CJSScriptDebuggerFrontendPrivate, parent)
 {
 	Q_D(CJSScriptDebuggerFrontend);
-	d->eventTimerId = startTimer(75); // pull events 
+	d->drainScheduled = false;
+	d->eventTimerId = startTimer(EVENT_POLL_INTERVAL); // pull events, until the backend is known to push
 }
 
 CJSScriptDebuggerFrontend::~CJSScriptDebuggerFrontend()
 {
 	Q_D(CJSScriptDebuggerFrontend);
-	killTimer(d->eventTimerId);
+	if (d->eventTimerId != 0)
+		killTimer(d->eventTimerId);
+}
+
+void CJSScriptDebuggerFrontend::setEventPolling(bool poll)
+{
+	Q_D(CJSScriptDebuggerFrontend);
+	if (poll && d->eventTimerId == 0)
+		d->eventTimerId = startTimer(EVENT_POLL_INTERVAL);
+	else if (!poll && d->eventTimerId != 0) {
+		killTimer(d->eventTimerId);
+		d->eventTimerId = 0;
+		d->scheduleDrain(); // pick up what was queued before the notifications were connected
+	}
+}
+
+bool CJSScriptDebuggerFrontend::isEventPolling() const
+{
+	Q_D(const CJSScriptDebuggerFrontend);
+	return d->eventTimerId != 0;
+}
+
+void CJSScriptDebuggerFrontend::onEventAvailable(int noOfPendingEvents)
+{
+	Q_D(CJSScriptDebuggerFrontend);
+
+	// a backend that notifies does not need to be polled
+	setEventPolling(false);
+
+	// the backend notifies once per event, coalesce them into a single drain
+	d->scheduleDrain();
+}
+
+void CJSScriptDebuggerFrontend::drainEvents()
+{
+	Q_D(CJSScriptDebuggerFrontend);
+	d->drainScheduled = false;
+
+	QVariantMap out;
+	out["Control"] = "PullEvents";
+	out["Max"] = MAX_EVENTS_PER_DRAIN;
+	emit sendRequest(out);
 }
 
 void CJSScriptDebuggerFrontend::processResponse(const QVariant& var)
@@ -58,6 +115,16 @@ void CJSScriptDebuggerFrontend::processResponse(const QVariant& var)
 	QVariantMap in = var.toMap();
 	if (in.contains("Event")) 
 		notifyEvent(in["Event"].toMap());
+	else if (in.contains("Events")) 
+	{
+		QVariantList events = in["Events"].toList();
+		foreach(const QVariant& event, events)
+			notifyEvent(event.toMap());
+
+		// a full batch may have left events behind, their notifications were already coalesced
+		if (events.size() >= MAX_EVENTS_PER_DRAIN)
+			d->scheduleDrain();
+	}
 	else if (in.contains("Result")) 
 		notifyCommandFinished((int)in["ID"].toInt(), in["Result"].toMap());
 	else if (in.contains("Response")) 
@@ -46,6 +46,11 @@ public:
     CJSScriptDebuggerFrontend(QObject *parent = 0);
     ~CJSScriptDebuggerFrontend();
 
+	// polling is only needed when the transport can not forward the backend's event notifications,
+	// it is turned off by the first notification received on onEventAvailable
+	void setEventPolling(bool poll);
+	bool isEventPolling() const;
+
 signals:
     void sendRequest(const QVariant& var);
 	void processCustom(const QVariant& var);
@@ -53,6 +58,7 @@ signals:
 public slots:
     void processResponse(const QVariant& var);
 	void sendCustom(const QVariant& var);
+	void onEventAvailable(int noOfPendingEvents);
 
 protected:
 	void processCommand(int id, const QVariantMap &command);
@@ -60,6 +66,9 @@ protected:
 
 	void timerEvent(QTimerEvent *e);
 
+private slots:
+	void drainEvents();
+
 private:
 	Q_DECLARE_PRIVATE(CJSScriptDebuggerFrontend)
     Q_DISABLE_COPY(CJSScriptDebuggerFrontend)
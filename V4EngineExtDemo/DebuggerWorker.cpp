@@ -8,17 +8,20 @@
 #include <QMetaObject>
 #include <QVariant>
 
-DebuggerWorker::DebuggerWorker(CV4EngineExt* engine, const QString frontendName, QObject* parent)
+DebuggerWorker::DebuggerWorker(CV4EngineExt* engine, const QString frontendName, bool attachOnDemand, QObject* parent)
     : QObject(parent),
     m_engine(engine),
-    m_frontendName(frontendName)
+    m_frontendName(frontendName),
+    m_attachOnDemand(attachOnDemand)
 {
 }
 
 void DebuggerWorker::startDebugger()
 {
     m_backend = new CV4ScriptDebuggerBackend(this);
-    m_backend->attachTo(m_engine);
+    m_backend->attachTo(m_engine, m_attachOnDemand);
+    m_backend->setPausedFrameLimit(32); // the CDP client loads the rest on demand with Debugger.getStackTrace
+    m_backend->setPropertyCounts(false); // CDP clients do not show them
 
     BackendSyncCall backendCall = [this](const QVariant& request) -> QVariant {
         QVariant response;
@@ -38,11 +41,30 @@ void DebuggerWorker::startDebugger()
     };
 
     m_frontend = new CdpDebuggerFrontend(backendCall, m_frontendName, this);
+    m_frontend->setAttachOnDemand(m_attachOnDemand);
+
+    // the backend lives in this process, so commands, results and events stay typed
+    m_frontend->setTypedBackend([this](int id, const SV4Command& command) -> SV4Result {
+        SV4Result result;
+
+        if (QThread::currentThread() == m_backend->thread()) {
+            result = m_backend->onCommand(id, command);
+        } else {
+            QMetaObject::invokeMethod(m_backend, [&]() { result = m_backend->onCommand(id, command); },
+                    Qt::BlockingQueuedConnection);
+        }
+
+        return result;
+    });
     m_frontend->startServer();
 
     connect(m_frontend, &CdpDebuggerFrontend::sendRequestToBackend, m_backend, &CV4ScriptDebuggerBackend::processRequest);
     connect(m_backend, &CV4ScriptDebuggerBackend::sendResponse, m_frontend, &CdpDebuggerFrontend::onBackendResponse);
     connect(m_backend, &CV4ScriptDebuggerBackend::newV4EventAvailable, m_frontend, &CdpDebuggerFrontend::onV4EventAvailable);
+    connect(m_frontend, &CdpDebuggerFrontend::sendCommandToBackend, m_backend, &CV4ScriptDebuggerBackend::processCommand);
+    connect(m_backend, &CV4ScriptDebuggerBackend::sendResult, m_frontend, &CdpDebuggerFrontend::onBackendResult);
+    connect(m_frontend, &CdpDebuggerFrontend::requestEventsFromBackend, m_backend, &CV4ScriptDebuggerBackend::pullEvents);
+    connect(m_backend, &CV4ScriptDebuggerBackend::sendEvents, m_frontend, &CdpDebuggerFrontend::onBackendEvents);
 
     qDebug() << "Debugger with CDP Adapter started";
 }
@@ -15,7 +15,7 @@ class DebuggerWorker : public QObject
 {
     Q_OBJECT
     public:
-        explicit DebuggerWorker(CV4EngineExt* engine, const QString frontendName, QObject* parent = nullptr);
+        explicit DebuggerWorker(CV4EngineExt* engine, const QString frontendName, bool attachOnDemand = false, QObject* parent = nullptr);
 
     public slots:
         void startDebugger();
@@ -23,6 +23,7 @@ class DebuggerWorker : public QObject
     private:
         CV4EngineExt* m_engine;
         QString m_frontendName;
+        bool m_attachOnDemand;
         CV4ScriptDebuggerBackend* m_backend = nullptr;
         CdpDebuggerFrontend* m_frontend = nullptr;
 };
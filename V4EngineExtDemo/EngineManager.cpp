@@ -5,13 +5,13 @@
 #include "DebuggerWorker.h"
 #include "EngineManager.h"
 
-EngineManager::EngineManager()
+EngineManager::EngineManager(bool attachOnDemand)
 {
     scriptEngine = new CV4EngineExt();
 
     // thread for the debugger
     debuggerThread = new QThread();
-    worker = new DebuggerWorker(scriptEngine, "JsRunner");
+    worker = new DebuggerWorker(scriptEngine, "JsRunner", attachOnDemand);
     worker->moveToThread(debuggerThread);
 
     QObject::connect(debuggerThread, &QThread::started, worker, &DebuggerWorker::startDebugger);
@@ -17,7 +17,7 @@ class EngineManager: public QObject
     Q_OBJECT
 
     public:
-        EngineManager();
+        EngineManager(bool attachOnDemand = false);
         ~EngineManager();
 
         CV4EngineExt& getEngine() { return *scriptEngine; }
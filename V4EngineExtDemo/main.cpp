@@ -114,13 +114,15 @@ int main(int argc, char *argv[])
     QCommandLineOption inputOpt({"i", "input"}, "Path to a JavaScript file.", "file");
     QCommandLineOption countOpt({"c", "count"}, "How many times to call the function.", "n", "1");
     QCommandLineOption intervalOpt({"t", "interval"}, "Interval in milliseconds between calls.", "ms", "1000");
+    QCommandLineOption onDemandOpt({"a", "attach-on-demand"}, "Run at full speed until a CDP client connects (breaks only in code compiled afterwards).");
 
     parser.addOption(inputOpt);
     parser.addOption(countOpt);
     parser.addOption(intervalOpt);
+    parser.addOption(onDemandOpt);
     parser.process(app);
 
-    EngineManager manager;
+    EngineManager manager(parser.isSet(onDemandOpt));
     CV4EngineExt &engine = manager.getEngine();
     Host hostObj;
 
@@ -22,16 +22,24 @@
 
 #include "V4DebugAgent.h"
 #include <QThread>
+#include <QDebug>
+#include <QDeadlineTimer>
 
 #include <private/qv4script_p.h>
+#include <private/qv4executablecompilationunit_p.h>
+#include <private/qv4functionobject_p.h>
 
 #if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
 #include <private/qv4stackframe_p.h>
 #endif
 
 #include "V4DebugJobs.h"
+#include "V4ScriptDebuggerApi.h"
 #include <QRegularExpression>
 
+// how long a job which timed out is waited for after its script was interrupted
+#define JOB_INTERRUPT_TIMEOUT 1000
+
 inline uint qHash(const CV4DebugAgent::SBreakKey& v, uint seed = 0)
 {
 	return v.lineNumber ^ qHash(v.fileName, seed);
@@ -73,21 +81,100 @@ QVariantMap SV4Breakpoint::toVariant() const
 // CV4DebugAgent
 //
 
-CV4DebugAgent::CV4DebugAgent(QV4::ExecutionEngine* engine) 
+CV4DebugAgent::CV4DebugAgent(QV4::ExecutionEngine* engine, CV4EngineItf* scripts) 
+	: m_sync(new SV4AgentSync)
+	, m_mutex(m_sync->Mutex)
+	, m_engineWaiter(m_sync->EngineWaiter)
+	, m_jobWaiter(m_sync->JobWaiter)
+	, m_jobQueue(m_sync->JobQueue)
 {
+	m_sync->Engine = engine;
 	m_engine = engine;
+	m_scripts = scripts;
+	m_lastScriptFunction = nullptr;
+	m_lastScriptDrops = 0;
+	m_lastScriptId = -1;
 	m_breakOnException = false;
 	m_pauseRequested = DontBreak;
 	m_paused = false;
 	m_currentFrame = nullptr;
+	m_stackCursor = nullptr;
+	m_frameCount = -1;
 	m_steppingMode = NotStepping;
 	m_breakpointIdCtr = 0;
-	m_haveBreakpoints = 0;
+	m_activeLines = nullptr;
+	m_functionLinesSwept = 0;
+	m_lastFunction = nullptr;
+	m_lastLines = nullptr;
+	m_jobsScheduled = false;
+	m_jobsPending.storeRelaxed(0);
+	m_resumeRequested = false;
 	m_runningJob = nullptr;
+	m_detached.storeRelaxed(0);
+}
+
+CV4DebugAgent::~CV4DebugAgent()
+{
+	delete m_breakpointLines.fetchAndStoreOrdered(nullptr);
+	qDeleteAll(m_retiredLines);
+	releaseFunctionLines(true);
 
+	// jobs which never got to run must not leave their callers waiting,
+	// the batches keep the lock and the waiter alive for as long as they are referenced
+	QMutexLocker locker(&m_mutex);
+	while (!m_jobQueue.isEmpty())
+		m_jobQueue.dequeue()->m_finished = true;
+	m_sync->Engine = nullptr;
+	m_jobWaiter.wakeAll();
+	locker.unlock();
+
+	// the agent is disposed of in the engine's thread
+	dropAllConditions();
+	qDeleteAll(m_staleConditions);
+}
+
+void CV4DebugAgent::attach()
+{
+	//
+	// Note: this must be called in the engine's thread while no script is on the stack,
+	//	only code compiled from now on contains the debug instructions the agent hooks into
+	//
+
+	if (m_engine->debugger() == this) { // still installed from an earlier session
+		QMutexLocker locker(&m_mutex);
+		m_scriptIdStack.clear(); // the frames entered while detached were not tracked
+		m_detached.storeRelease(0);
+		return;
+	}
+	if (m_engine->debugger()) {
+		qWarning() << "V4 engine already has a debugger installed";
+		return;
+	}
 	m_engine->setDebugger(this);
 }
 
+void CV4DebugAgent::detach()
+{
+	QMutexLocker locker(&m_mutex);
+
+	// disarm everything that could still halt the engine
+	m_breakOnException = false;
+	m_pauseRequested = DontBreak;
+	m_steppingMode = NotStepping;
+	dropAllConditions();
+	m_breakpoints.clear();
+	m_breakpointHash.clear();
+	publishBreakpointLines();
+	if (m_paused) {
+		m_resumeRequested = true;
+		m_engineWaiter.wakeAll();
+	}
+
+	// the engine owns the agent once installed and has no way to uninstall it,
+	// so it stays installed and passes everything through until attach is called again
+	m_detached.storeRelease(1);
+}
+
 void CV4DebugAgent::pause(PauseReason reason)
 {
 	QMutexLocker locker(&m_mutex);
@@ -104,10 +191,11 @@ void CV4DebugAgent::resume(Stepping stepping)
 
 	m_currentFrame = m_engine->currentStackFrame;
 	m_steppingMode = stepping;
+	m_resumeRequested = true;
 	m_engineWaiter.wakeAll();
 }
 
-void CV4DebugAgent::runJobInEngine(class CV4DebugJob* job, bool bWait)
+CV4JobBatchPtr CV4DebugAgent::queueJobs(const QList<CV4DebugJobPtr>& jobs)
 {
 	QMutexLocker locker(&m_mutex);
 
@@ -116,30 +204,123 @@ void CV4DebugAgent::runJobInEngine(class CV4DebugJob* job, bool bWait)
 	// the user of this agent must ensure that it always lives in the same thread as the engine.
 	Q_ASSERT(QThread::currentThread() != QObject::thread());
 
-	m_runningJob = job; // schedule job
-	if (m_paused) // resume engine when paused, signalAndWait will run the job
+	CV4JobBatchPtr batch(new CV4JobBatch(m_sync, jobs));
+	m_jobQueue.enqueue(batch);
+	if (m_paused) // wake the engine when paused, signalAndWait runs the queue
 		m_engineWaiter.wakeAll(); 
-	else // invoke function in the engines thread
-		QMetaObject::invokeMethod(this, "runJob", Qt::QueuedConnection);
-		/*QMetaObject::invokeMethod(this, [&](){
-				runJob(); // or like this
-			}, Qt::QueuedConnection);*/
-		
-	if (bWait)
-		m_jobWaiter.wait(&m_mutex);
+	else {
+		// a busy engine runs the jobs at its next instruction, an idle one from its event loop,
+		// whichever comes first picks up all batches queued until then
+		m_jobsPending.storeRelease(1);
+		if (!m_jobsScheduled) {
+			m_jobsScheduled = true;
+			QMetaObject::invokeMethod(this, "runJob", Qt::QueuedConnection);
+		}
+	}
+	return batch;
+}
+
+bool CV4DebugAgent::runJobsInEngine(const QList<CV4DebugJobPtr>& jobs, int timeout)
+{
+	CV4JobBatchPtr batch = queueJobs(jobs);
+	if (batch->waitForFinished(timeout))
+		return true;
+	if (batch->cancel())
+		return false;
+	// it already started, a job stuck in a native call is left to the batch which keeps it alive
+	bool interrupted = batch->interrupt();
+	return batch->waitForFinished(JOB_INTERRUPT_TIMEOUT) && !interrupted;
+}
+
+bool CV4DebugAgent::runJobInEngine(const CV4DebugJobPtr& job, int timeout)
+{
+	return runJobsInEngine(QList<CV4DebugJobPtr>() << job, timeout);
 }
 
 void CV4DebugAgent::runJob()
 {
 	QMutexLocker locker(&m_mutex);
 
-	if (m_runningJob) {
-		//m_mutex.unlock();
-		m_runningJob->run();
-		//m_mutex.lock();
+	m_jobsScheduled = false;
+	runQueuedJobs();
+}
+
+void CV4DebugAgent::runQueuedJobs()
+{
+	m_jobsPending.storeRelaxed(0);
+	if (m_jobQueue.isEmpty())
+		return;
+
+	while (!m_jobQueue.isEmpty()) {
+		CV4JobBatchPtr batch = m_jobQueue.dequeue();
+		batch->m_running = true;
+
+		// the requesting side must be able to time out and interrupt a long running job
+		m_mutex.unlock();
+		foreach(const CV4DebugJobPtr& job, batch->m_jobs) {
+			m_runningJob = job.data();
+			job->run();
+		}
+		m_runningJob = nullptr;
+		m_mutex.lock();
+
+		if (batch->m_interrupted) // before any other script gets to run
+			m_engine->isInterrupted.storeRelaxed(false);
+		batch->m_finished = true;
 	}
-	m_jobWaiter.wakeAll();
-	m_runningJob = nullptr;
+	m_jobWaiter.wakeAll(); // one hand off for all finished batches
+}
+
+bool CV4JobBatch::isFinished() const
+{
+	QMutexLocker locker(&m_sync->Mutex);
+	return m_finished;
+}
+
+bool CV4JobBatch::wasCanceled() const
+{
+	QMutexLocker locker(&m_sync->Mutex);
+	return m_canceled;
+}
+
+bool CV4JobBatch::waitForFinished(int timeout) const
+{
+	QDeadlineTimer deadline(timeout); // negative never expires
+	QMutexLocker locker(&m_sync->Mutex);
+	while (!m_finished) {
+		if (!m_sync->JobWaiter.wait(&m_sync->Mutex, deadline))
+			return m_finished;
+	}
+	return true;
+}
+
+bool CV4JobBatch::cancel()
+{
+	QMutexLocker locker(&m_sync->Mutex);
+	if (m_finished || m_running)
+		return false;
+
+	for (int i = 0; i < m_sync->JobQueue.size(); i++) {
+		if (m_sync->JobQueue[i].data() == this) {
+			m_sync->JobQueue.removeAt(i);
+			break;
+		}
+	}
+	m_finished = m_canceled = true;
+	m_sync->JobWaiter.wakeAll();
+	return true;
+}
+
+bool CV4JobBatch::interrupt()
+{
+	QMutexLocker locker(&m_sync->Mutex);
+	if (!m_running || m_finished || !m_sync->Engine)
+		return false;
+
+	// the interpreter checks the flag on calls and backward jumps, a native call is not interrupted
+	m_interrupted = true;
+	m_sync->Engine->isInterrupted.storeRelaxed(true);
+	return true;
 }
 
 void CV4DebugAgent::runUntil(const QString& fileName, int lineNumber)
@@ -149,27 +330,99 @@ void CV4DebugAgent::runUntil(const QString& fileName, int lineNumber)
 	clearRunUntil();
 	// set a dummy breakpoint
 	m_breakpointHash.insert(SBreakKey(fileName, lineNumber), (SV4Breakpoint*)-1);
+	publishBreakpointLines();
 }
 
 void CV4DebugAgent::clearRunUntil()
 {
 	auto keys = m_breakpointHash.keys((SV4Breakpoint*)-1);
+	if (keys.isEmpty())
+		return;
 	while (!keys.isEmpty())
 		m_breakpointHash.remove(keys.takeFirst());
+	publishBreakpointLines();
 }
 
-QV4::CppStackFrame* CV4DebugAgent::findFrame(QV4::ExecutionEngine* engine, int frameNr)
+void CV4DebugAgent::publishBreakpointLines()
+{
+	// Note: must be called with m_mutex held
+
+	SV4BreakpointLines* lines = nullptr;
+	for (auto I = m_breakpointHash.constBegin(); I != m_breakpointHash.constEnd(); ++I) {
+		if (I.value() != (SV4Breakpoint*)-1 && !I.value()->enabled)
+			continue;
+		if (I.key().lineNumber < 0)
+			continue;
+		if (!lines)
+			lines = new SV4BreakpointLines();
+		QBitArray& bits = lines->scripts[I.key().fileName];
+		if (bits.size() <= I.key().lineNumber)
+			bits.resize(I.key().lineNumber + 1);
+		bits.setBit(I.key().lineNumber);
+	}
+
+	// the engine thread may still be reading the old table, it gets released once the engine has picked up the new one
+	SV4BreakpointLines* old = m_breakpointLines.fetchAndStoreOrdered(lines);
+	if (old)
+		m_retiredLines.append(old);
+}
+
+static inline QV4::CppStackFrame* parentFrame(QV4::CppStackFrame* frame)
 {
-	QV4::CppStackFrame* frame = engine->currentStackFrame;
-	for (int i = 0; frame && i < frameNr; i++)
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-		frame = frame->parent;
+	return frame->parent;
 #else
-		frame = frame->parentFrame();
+	return frame->parentFrame();
 #endif
+}
+
+QV4::CppStackFrame* CV4DebugAgent::findFrame(QV4::ExecutionEngine* engine, int frameNr)
+{
+	QV4::CppStackFrame* frame = engine->currentStackFrame;
+	for (int i = 0; frame && i < frameNr; i++)
+		frame = parentFrame(frame);
 	return frame;
 }
 
+//
+// Note: while paused the engine is parked in signalAndWait and can not continue without m_mutex,
+//	so its frames can be read from the debugger's thread, jobs only push frames on top of them
+//
+
+int CV4DebugAgent::frameCount() const
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (!m_paused)
+		return 0;
+
+	if (m_frameCount == -1) { // walk the remaining frames without resolving any names
+		m_frameCount = m_stackTrace.size();
+		for (QV4::CppStackFrame* frame = m_stackCursor; frame; frame = parentFrame(frame))
+			m_frameCount++;
+	}
+	return m_frameCount;
+}
+
+QVector<QV4::StackFrame> CV4DebugAgent::stackTrace(int from, int count) const
+{
+	QMutexLocker locker(&m_mutex);
+
+	if (!m_paused || from < 0)
+		return QVector<QV4::StackFrame>();
+
+	int end = (count < 0 || count > INT_MAX - from) ? INT_MAX : from + count;
+	for (; m_stackCursor && m_stackTrace.size() < end; m_stackCursor = parentFrame(m_stackCursor)) {
+		QV4::StackFrame frame;
+		frame.source = m_stackCursor->source();
+		frame.function = m_stackCursor->function();
+		frame.line = qAbs(m_stackCursor->lineNumber());
+		frame.column = -1;
+		m_stackTrace.append(frame);
+	}
+	return m_stackTrace.mid(from, count);
+}
+
 QV4::Heap::ExecutionContext* CV4DebugAgent::findContext(QV4::ExecutionEngine* engine, int frameNr)
 {
 	QV4::CppStackFrame* frame = findFrame(engine, frameNr);
@@ -183,6 +436,18 @@ QV4::Heap::ExecutionContext* CV4DebugAgent::findScope(QV4::Heap::ExecutionContex
 	return ctx;
 }
 
+QString CV4DebugAgent::scopeType(QV4::Heap::ExecutionContext* ctx)
+{
+	switch (ctx->type) {
+	default:												return QStringLiteral("Unknown");
+	case QV4::Heap::ExecutionContext::Type_GlobalContext:	return QStringLiteral("GlobalContext");
+	case QV4::Heap::ExecutionContext::Type_WithContext:		return QStringLiteral("WithContext");
+	case QV4::Heap::ExecutionContext::Type_QmlContext:		return QStringLiteral("QmlContext");
+	case QV4::Heap::ExecutionContext::Type_BlockContext:	return QStringLiteral("BlockContext");
+	case QV4::Heap::ExecutionContext::Type_CallContext:		return QStringLiteral("CallContext");
+	}
+}
+
 QVector<SV4Scope> CV4DebugAgent::getScopes(int frame)
 {
 	QVector<SV4Scope> scopes;
@@ -190,31 +455,26 @@ QVector<SV4Scope> CV4DebugAgent::getScopes(int frame)
 		return scopes;
 	
 	QV4::Heap::ExecutionContext* ec = findFrame(m_engine, frame)->context()->d();
-	for (int i = 0; ec; ec = ec->outer, i++) {
-		QString type;
-		switch (ec->type) {
-		default:												type = "Unknown"; break;
-		case QV4::Heap::ExecutionContext::Type_GlobalContext:	type = "GlobalContext"; break;
-		case QV4::Heap::ExecutionContext::Type_WithContext:		type = "WithContext"; break;
-		case QV4::Heap::ExecutionContext::Type_QmlContext:		type = "QmlContext"; break;
-		case QV4::Heap::ExecutionContext::Type_BlockContext:	type = "BlockContext"; break;
-		case QV4::Heap::ExecutionContext::Type_CallContext:		type = "CallContext"; break;
-		}
-		scopes.append(SV4Scope{ i, type });
-	}
+	for (int i = 0; ec; ec = ec->outer, i++)
+		scopes.append(SV4Scope{ i, scopeType(ec) });
 	return scopes;
 }
 
-int CV4DebugAgent::setBreakpoint(const SV4Breakpoint& Breakpoint)
+int CV4DebugAgent::setBreakpoint(const SV4Breakpoint& Breakpoint, int id)
 {
 	QMutexLocker locker(&m_mutex);
 
-	int id = ++m_breakpointIdCtr;
+	if (id <= 0)
+		id = ++m_breakpointIdCtr;
+	else if (id > m_breakpointIdCtr) // restored breakpoint, keep its id
+		m_breakpointIdCtr = id;
 
 	SV4Breakpoint& bp = m_breakpoints[id];
+	dropCondition(&bp);
 	bp = Breakpoint;
+	prepareCondition(&bp);
 	m_breakpointHash.insert(SBreakKey(bp.fileName, bp.lineNumber), &bp);
-	m_haveBreakpoints = true;
+	publishBreakpointLines();
 
 	return id;
 }
@@ -223,18 +483,23 @@ void CV4DebugAgent::deleteBreakpoint(int id)
 {
 	QMutexLocker locker(&m_mutex);
 
-	SV4Breakpoint bp = m_breakpoints.take(id);
-	m_breakpointHash.remove(SBreakKey(bp.fileName, bp.lineNumber));
-	m_haveBreakpoints = !m_breakpoints.isEmpty();
+	auto I = m_breakpoints.find(id);
+	if (I == m_breakpoints.end())
+		return;
+	dropCondition(&*I);
+	m_breakpointHash.remove(SBreakKey(I->fileName, I->lineNumber));
+	m_breakpoints.erase(I);
+	publishBreakpointLines();
 }
 
 void CV4DebugAgent::deleteAllBreakpoints()
 {
 	QMutexLocker locker(&m_mutex);
 
+	dropAllConditions();
 	m_breakpoints.clear();
 	m_breakpointHash.clear();
-	m_haveBreakpoints = false;
+	publishBreakpointLines();
 }
 
 bool CV4DebugAgent::updateBreakpoint(int id, const SV4Breakpoint& Breakpoint)
@@ -245,8 +510,13 @@ bool CV4DebugAgent::updateBreakpoint(int id, const SV4Breakpoint& Breakpoint)
 	if (I == m_breakpoints.end())
 		return false;
 	m_breakpointHash.remove(SBreakKey(I->fileName, I->lineNumber));
+	dropCondition(&*I);
+	int passCount = (I->fileName == Breakpoint.fileName && I->lineNumber == Breakpoint.lineNumber) ? I->passCount : 0;
 	*I = Breakpoint;
+	I->passCount = passCount;
+	prepareCondition(&*I);
 	m_breakpointHash.insert(SBreakKey(I->fileName, I->lineNumber), &*I);
+	publishBreakpointLines();
 	return true;
 }
 
@@ -278,29 +548,118 @@ CV4DebugAgent::PauseReason CV4DebugAgent::checkBreakpoints(const QString& fileNa
 	if (!bp->enabled)
 		return DontBreak;
 
-	if (!bp->condition.isEmpty()) {
-		Q_ASSERT(m_runningJob == nullptr);
-
-		m_runningJob = (CV4DebugJob*)-1; // set dumy job to not enter maybeBreakAtInstruction
-		QV4::Scope scope(m_engine);
-		QV4::ScopedValue result = CV4ScriptJob::exec(m_engine, scope, bp->condition, -1/*, -1*/);
-		m_runningJob = nullptr;
-		if (!result->toBoolean())
-			return DontBreak;
-	}
+	bp->passCount++;
 
+	// as in gdb the condition is not checked while the breakpoint is being ignored
 	if (bp->ignoreCount > 0) {
 		bp->ignoreCount--;
 		return DontBreak;
 	}
 
-	if (bp->singleShot)
+	if (!bp->condition.isEmpty() && !evaluateCondition(bp))
+		return DontBreak;
+
+	if (bp->singleShot) {
 		bp->enabled = false;
+		publishBreakpointLines();
+	}
 
 	bp->hitCount++;
 	return BreakPointHit;
 }
 
+bool CV4DebugAgent::evaluateCondition(const SV4Breakpoint* bp)
+{
+	//
+	// Note: this must be called in the engine's thread with m_mutex held,
+	//	the condition is compiled on its first hit and reused until the breakpoint changes
+	//
+
+	SV4Condition& cond = m_conditions[bp];
+	if (cond.native.source() != bp->condition)
+		cond.native = CV4DebugCondition(bp->condition);
+	if (cond.native.isNative()) {
+		CV4DebugCondition::EResult result = cond.native.evaluate(m_engine, bp->passCount);
+		if (result != CV4DebugCondition::eFallback)
+			return result == CV4DebugCondition::eTrue;
+	}
+
+	qDeleteAll(m_staleConditions);
+	m_staleConditions.clear();
+
+	Q_ASSERT(m_runningJob == nullptr);
+	m_runningJob = (CV4DebugJob*)-1; // set dumy job to not enter maybeBreakAtInstruction
+
+	QV4::CppStackFrame* frame = m_engine->currentStackFrame;
+	QV4::Scope scope(m_engine);
+	QV4::ScopedContext ctx(scope, m_engine->currentContext());
+
+	bool strict = frame->v4Function->isStrict();
+	if (cond.source != bp->condition || cond.strict != strict) {
+		delete cond.script;
+		cond.source = bp->condition;
+		cond.strict = strict;
+		// $hitCount is no JS name, conditions beyond the native grammar get it as an argument
+		cond.hitCount = bp->condition.contains(QLatin1String("$hitCount"));
+		QString source = cond.hitCount ? "(function ($hitCount) { return (" + bp->condition + "\n); })" : bp->condition;
+		cond.script = new QV4::Script(ctx, QV4::Compiler::ContextType::Eval, source);
+		cond.script->strictMode = strict;
+		cond.script->inheritContext = true; // names are resolved through the context passed on each call
+		cond.script->parse();
+		if (m_engine->hasException || !cond.script->vmFunction) {
+			m_engine->catchException();
+			delete cond.script;
+			cond.script = nullptr;
+		}
+	}
+
+	bool result = true; // a condition which does not compile always breaks, so the user notices it
+	if (cond.script) {
+		QV4::ScopedValue thisObject(scope, frame->thisObject());
+		QV4::ScopedValue value(scope, cond.script->vmFunction->call(thisObject, nullptr, 0, ctx));
+		if (cond.hitCount && !m_engine->hasException) {
+			QV4::ScopedFunctionObject function(scope, value);
+			QV4::Value* argv = scope.alloc(1);
+			argv[0] = QV4::Value::fromInt32(bp->passCount);
+			value = function ? function->call(thisObject, argv, 1) : QV4::Encode::undefined();
+		}
+		if (m_engine->hasException) { // don't leak the exception into the debuggee
+			m_engine->catchException();
+			result = false;
+		} else
+			result = value->toBoolean();
+	}
+
+	m_runningJob = nullptr;
+	return result;
+}
+
+void CV4DebugAgent::prepareCondition(const SV4Breakpoint* bp)
+{
+	// parsing the native form needs no engine access, so unlike the JS form it is done right away
+	if (!bp->condition.isEmpty())
+		m_conditions[bp].native = CV4DebugCondition(bp->condition);
+}
+
+void CV4DebugAgent::dropCondition(const SV4Breakpoint* bp)
+{
+	auto I = m_conditions.find(bp);
+	if (I == m_conditions.end())
+		return;
+	if (I->script)
+		m_staleConditions.append(I->script);
+	m_conditions.erase(I);
+}
+
+void CV4DebugAgent::dropAllConditions()
+{
+	for (auto I = m_conditions.begin(); I != m_conditions.end(); ++I) {
+		if (I->script)
+			m_staleConditions.append(I->script);
+	}
+	m_conditions.clear();
+}
+
 static CV4SourceLocation convertSrcLocationQmltoCv4(const QQmlSourceLocation &srcLoc)
 {
 	return CV4SourceLocation(srcLoc.sourceFile, srcLoc.line, srcLoc.column);
@@ -315,9 +674,10 @@ void CV4DebugAgent::signalAndWait(PauseReason reason)
 	// cleanup dummy breakpoints
 	clearRunUntil();
 
-	// capture stack trace for this break
-	// saves on computation if the caller accesses the trace one frame at a time
-	m_stackTrace = m_engine->stackTrace();
+	// the stack is only captured once the debugger asks for it, see stackTrace()
+	m_stackTrace.clear();
+	m_stackCursor = m_engine->currentStackFrame;
+	m_frameCount = -1;
 
 	// notify the debugger
 	CV4SourceLocation srcLoc;
@@ -335,22 +695,101 @@ void CV4DebugAgent::signalAndWait(PauseReason reason)
 	else
 		emit debuggerPaused(this, reason, QStringLiteral("unknown"), srcLoc, 1);
 
-	// wait and run jobs
+	// wait and run jobs, including the ones queued before the engine paused
+	m_resumeRequested = false;
 	for (;;) {
-		m_engineWaiter.wait(&m_mutex);
+		runQueuedJobs();
 
-		if (!m_runningJob)
+		if (m_resumeRequested)
 			break;
-		
-		//m_mutex.unlock();
-		m_runningJob->run();
-		//m_mutex.lock();
 
-		m_jobWaiter.wakeAll();
-		m_runningJob = nullptr;
+		m_engineWaiter.wait(&m_mutex);
 	}
 
 	m_paused = false;
+	m_stackTrace.clear();
+	m_stackCursor = nullptr;
+}
+
+bool CV4DebugAgent::hasBreakpointAt(QV4::CppStackFrame* frame) const
+{
+	//
+	// Note: this is called for every instruction, scripts without breakpoints only pay for a pointer compare,
+	//	the line bitmap is resolved once per function, the lookup is lock free and only ever called from the engine thread
+	//
+
+	SV4BreakpointLines* lines = m_breakpointLines.loadAcquire();
+	if (lines != m_activeLines) {
+		m_activeLines = lines;
+		releaseFunctionLines(true);
+		m_lastFunction = nullptr;
+
+		// the engine no longer references any of the retired tables
+		if (m_mutex.tryLock()) {
+			for (auto I = m_retiredLines.begin(); I != m_retiredLines.end();) {
+				if (*I == m_activeLines)
+					++I;
+				else {
+					delete *I;
+					I = m_retiredLines.erase(I);
+				}
+			}
+			m_mutex.unlock();
+		}
+	}
+
+	if (!m_activeLines || !frame)
+		return false;
+
+	if (frame->v4Function != m_lastFunction) {
+		m_lastFunction = frame->v4Function;
+
+		auto I = m_functionLines.find(m_lastFunction);
+		if (I == m_functionLines.end()) {
+			if (m_functionLines.size() >= 2 * m_functionLinesSwept + 64)
+				releaseFunctionLines(false);
+
+			SFunctionLines entry;
+			auto J = m_activeLines->scripts.constFind(SBreakKey(normalizeScriptName(m_lastFunction->sourceFile()), 0).fileName);
+			if (J != m_activeLines->scripts.constEnd())
+				entry.lines = &*J;
+			entry.unit = m_lastFunction->executableCompilationUnit();
+			entry.unit->addref();
+			I = m_functionLines.insert(m_lastFunction, entry);
+		}
+		m_lastLines = I->lines;
+	}
+
+	if (!m_lastLines)
+		return false;
+	int lineNumber = frame->lineNumber();
+	return lineNumber >= 0 && lineNumber < m_lastLines->size() && m_lastLines->testBit(lineNumber);
+}
+
+void CV4DebugAgent::releaseFunctionLines(bool all) const
+{
+	//
+	// Note: a unit only referenced by us has no functions left which could run, its entries can go,
+	//	the sweep runs whenever the cache doubled so it stays amortized constant per lookup
+	//
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+	const int unitRefs = 2; // ours and the engine's compilation unit cache
+#else
+	const int unitRefs = 1;
+#endif
+
+	for (auto I = m_functionLines.begin(); I != m_functionLines.end();) {
+		if (!all && I->unit->count() > unitRefs)
+			++I;
+		else {
+			if (I.key() == m_lastFunction)
+				m_lastFunction = nullptr;
+			I->unit->release();
+			I = m_functionLines.erase(I);
+		}
+	}
+	m_functionLinesSwept = m_functionLines.size();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////
@@ -359,9 +798,13 @@ void CV4DebugAgent::signalAndWait(PauseReason reason)
 
 bool CV4DebugAgent::pauseAtNextOpportunity() const
 {
+	if (m_detached.loadRelaxed())
+		return false;
+
 	return m_pauseRequested
-		|| m_haveBreakpoints
-		|| m_steppingMode >= StepOver;
+		|| m_jobsPending.loadRelaxed()
+		|| m_steppingMode >= StepOver
+		|| hasBreakpointAt(m_engine->currentStackFrame);
 }
 
 void CV4DebugAgent::maybeBreakAtInstruction()
@@ -371,6 +814,10 @@ void CV4DebugAgent::maybeBreakAtInstruction()
 
 	QMutexLocker locker(&m_mutex);
 
+	// safepoint, run the jobs queued while the engine was busy
+	if (m_jobsPending.loadRelaxed())
+		runQueuedJobs();
+
 	switch (m_steppingMode) {
 	case StepOver:
 		if (m_currentFrame != m_engine->currentStackFrame)
@@ -388,7 +835,7 @@ void CV4DebugAgent::maybeBreakAtInstruction()
 		pause = m_pauseRequested;
 		m_pauseRequested = DontBreak;
 	}
-	else if (m_haveBreakpoints)
+	else if (hasBreakpointAt(m_engine->currentStackFrame))
 		pause = checkBreakpoints(m_engine->currentStackFrame->v4Function->sourceFile(), m_engine->currentStackFrame->lineNumber());
 	if (pause != DontBreak)
 		signalAndWait(pause);
@@ -396,24 +843,42 @@ void CV4DebugAgent::maybeBreakAtInstruction()
 
 void CV4DebugAgent::enteringFunction()
 {
-	if (m_runningJob)
+	if (m_runningJob || m_detached.loadRelaxed())
 		return;
 	QMutexLocker locker(&m_mutex);
 
-	QString fileName = QUrl(m_engine->currentStackFrame->v4Function->sourceFile()).fileName();
-	m_scriptIdStack.append(fileName);
+	m_scriptIdStack.append(scriptIdOf(m_engine->currentStackFrame->v4Function));
 
 	if (m_steppingMode == StepIn)
 		m_currentFrame = m_engine->currentStackFrame;
 }
 
+qint64 CV4DebugAgent::scriptIdOf(const QV4::Function* function)
+{
+	if (!m_scripts)
+		return -1;
+
+	// loops calling the same function don't need to look it up again
+	QString source = function->sourceFile();
+	int drops = m_scripts->scriptDropCount();
+	if (function != m_lastScriptFunction || drops != m_lastScriptDrops || source != m_lastScriptSource) {
+		m_lastScriptFunction = function;
+		m_lastScriptSource = source;
+		m_lastScriptDrops = drops;
+		m_lastScriptId = m_scripts->getScriptIdBySource(source);
+		m_scripts->scriptEntered(m_lastScriptId, function);
+	}
+	return m_lastScriptId;
+}
+
 void CV4DebugAgent::leavingFunction(const QV4::ReturnedValue& retVal)
 {
-	if (m_runningJob)
+	if (m_runningJob || m_detached.loadRelaxed())
 		return;
 	QMutexLocker locker(&m_mutex);
 
-	m_scriptIdStack.removeLast();
+	if (!m_scriptIdStack.isEmpty()) // may have been entered while detached
+		m_scriptIdStack.removeLast();
 
 	if (m_steppingMode != NotStepping && m_currentFrame == m_engine->currentStackFrame) {
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
@@ -427,7 +892,7 @@ void CV4DebugAgent::leavingFunction(const QV4::ReturnedValue& retVal)
 
 void CV4DebugAgent::aboutToThrow()
 {
-	if (!m_breakOnException)
+	if (!m_breakOnException || m_detached.loadRelaxed())
 		return;
 
 	if (m_runningJob) // ignore exceptions in jobs
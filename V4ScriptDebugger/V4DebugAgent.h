@@ -33,8 +33,17 @@
 
 #include <QtCore/qmutex.h>
 #include <QtCore/qwaitcondition.h>
+#include <QtCore/qatomic.h>
+#include <QtCore/qbitarray.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qsharedpointer.h>
+
+#include "V4DebugCondition.h"
 
 class CV4DebugJob;
+typedef QSharedPointer<CV4DebugJob> CV4DebugJobPtr;
+class CV4EngineItf;
+namespace QV4 { struct Script; class ExecutableCompilationUnit; }
 
 struct SV4Breakpoint {
 
@@ -49,6 +58,21 @@ struct SV4Breakpoint {
     QString condition;
     QVariant data;
     int hitCount;
+    int passCount = 0; // times the enabled breakpoint was reached, exposed to conditions as $hitCount
+};
+
+// immutable snapshot of all lines that may break, published to the engine thread
+struct SV4BreakpointLines {
+    QHash<QString, QBitArray> scripts; // normalized script file name -> line bitmap
+};
+
+// breakpoint condition compiled in the engine thread, called with the context of the hit frame
+struct SV4Condition {
+    CV4DebugCondition native;
+    QString source;
+    bool strict = false;
+    bool hitCount = false; // compiled as a function taking $hitCount, called with the pass count
+    QV4::Script* script = nullptr; // nullptr if the condition failed to compile
 };
 
 struct SV4Scope {
@@ -67,15 +91,55 @@ struct SV4Scope {
     };
 Q_DECLARE_METATYPE(CV4SourceLocation)
 
+class CV4JobBatch;
+typedef QSharedPointer<CV4JobBatch> CV4JobBatchPtr;
+
+// the agent's lock and job queue, shared with the batches it handed out as those may outlive the agent
+struct SV4AgentSync
+{
+    QMutex Mutex;
+    QWaitCondition EngineWaiter; // holds the engine untill the debugger resumes
+    QWaitCondition JobWaiter; // signaled whenever queued batches finished
+    QQueue<CV4JobBatchPtr> JobQueue;
+    QV4::ExecutionEngine* Engine = nullptr; // reset once the agent is gone
+};
+
+// completion handle of jobs queued with CV4DebugAgent::queueJobs, it shares the ownership of its
+// jobs, so a job which could not be stopped in time stays valid after the requester gave up, the jobs of all
+// batches queued until the engine picks them up run back to back in one wake up
+class CV4JobBatch
+{
+public:
+    bool isFinished() const;
+    bool wasCanceled() const;
+    bool waitForFinished(int timeout = -1) const; // false if the jobs did not run within timeout ms
+    bool cancel(); // drops the batch unless it already started
+    bool interrupt(); // aborts the script a started job is executing, a native call runs on until it returns
+
+protected:
+    friend class CV4DebugAgent;
+    CV4JobBatch(const QSharedPointer<SV4AgentSync>& sync, const QList<CV4DebugJobPtr>& jobs) : m_sync(sync), m_jobs(jobs) {}
+
+    QSharedPointer<SV4AgentSync> m_sync;
+    QList<CV4DebugJobPtr> m_jobs;
+    bool m_running = false; // guarded by m_sync->Mutex
+    bool m_finished = false;
+    bool m_canceled = false;
+    bool m_interrupted = false;
+};
+
 class CV4DebugAgent : public QV4::Debugging::Debugger
 {
     Q_OBJECT
 
 public:
-    CV4DebugAgent(QV4::ExecutionEngine* engine);
+    CV4DebugAgent(QV4::ExecutionEngine* engine, CV4EngineItf* scripts = nullptr);
+    ~CV4DebugAgent();
 
     QV4::ExecutionEngine* engine() const { return m_engine; }
 
+    void detach();
+
     enum Stepping {
         NotStepping = 0,
         StepOut,
@@ -98,15 +162,22 @@ public:
     void resume(Stepping stepping = NotStepping);
     void runUntil(const QString& fileName, int lineNumber);
 
-    QVector<QV4::StackFrame> stackTrace() const { return m_stackTrace; }
+    // the stack of the current pause, frames are only materialized as far as they are asked for,
+    // must not be called from within a job
+    int frameCount() const;
+    QVector<QV4::StackFrame> stackTrace(int from = 0, int count = -1) const;
     QVector<SV4Scope> getScopes(int frameNr);
 
-    void runJobInEngine(class CV4DebugJob* job, bool bWait = true);
+    // must be called from a different thread than the engine's, a running engine picks up
+    // the jobs at its next safepoint, on timeout the jobs are canceled or interrupted and false is returned
+    CV4JobBatchPtr queueJobs(const QList<CV4DebugJobPtr>& jobs);
+    bool runJobsInEngine(const QList<CV4DebugJobPtr>& jobs, int timeout = -1);
+    bool runJobInEngine(const CV4DebugJobPtr& job, int timeout = -1);
 
     void setBreakOnException(bool set = true) { m_breakOnException = set; }
     bool breakOnException() const { return m_breakOnException; }
 
-    int setBreakpoint(const SV4Breakpoint& Breakpoint);
+    int setBreakpoint(const SV4Breakpoint& Breakpoint, int id = 0);
     QMap<int, SV4Breakpoint> getBreakpoints() const { QMutexLocker locker(&m_mutex); return m_breakpoints; }
     void deleteBreakpoint(int id);
     void deleteAllBreakpoints();
@@ -119,15 +190,20 @@ public:
         int lineNumber;
     };
 
-    QSet<QString> getCurrentScripts() const { QMutexLocker locker(&m_mutex); return QSet<QString>(m_scriptIdStack.begin(), m_scriptIdStack.end()); }
+    bool isRunningScript() const { QMutexLocker locker(&m_mutex); return !m_scriptIdStack.isEmpty(); }
+    QSet<qint64> getCurrentScripts() const { QMutexLocker locker(&m_mutex); return QSet<qint64>(m_scriptIdStack.begin(), m_scriptIdStack.end()); }
 
     static QV4::CppStackFrame* findFrame(QV4::ExecutionEngine* engine, int frameNr);
     static QV4::Heap::ExecutionContext* findContext(QV4::ExecutionEngine* engine, int frameNr);
     static QV4::Heap::ExecutionContext* findScope(QV4::Heap::ExecutionContext* ctx, int scopeNr);
+    static QString scopeType(QV4::Heap::ExecutionContext* ctx);
 
 signals:
     void debuggerPaused(CV4DebugAgent* self, int reason, const QString& fileName, CV4SourceLocation location, int lineNumber);
 
+public slots:
+    void attach();
+
 private slots:
     void runJob();
 
@@ -139,31 +215,75 @@ protected:
     virtual void aboutToThrow() override;
 
     PauseReason checkBreakpoints(const QString& fileName, int lineNumber);
+    bool evaluateCondition(const SV4Breakpoint* bp);
+    void prepareCondition(const SV4Breakpoint* bp);
+    void dropCondition(const SV4Breakpoint* bp);
+    void dropAllConditions();
     void clearRunUntil();
+    void publishBreakpointLines();
+    bool hasBreakpointAt(QV4::CppStackFrame* frame) const;
+    void releaseFunctionLines(bool all) const;
+    qint64 scriptIdOf(const QV4::Function* function);
     void signalAndWait(PauseReason reason);
+    void runQueuedJobs();
 
     QV4::ExecutionEngine* m_engine;
     bool m_breakOnException;
     PauseReason m_pauseRequested;
     bool m_paused;
     QV4::CppStackFrame* m_currentFrame;
-    QVector<QV4::StackFrame> m_stackTrace;
+
+    // stack of the current pause, captured on demand, guarded by m_mutex
+    mutable QVector<QV4::StackFrame> m_stackTrace;
+    mutable QV4::CppStackFrame* m_stackCursor; // next frame to materialize
+    mutable int m_frameCount;
+
     Stepping m_steppingMode;
 
     // breakpoints
     QHash<SBreakKey, SV4Breakpoint*> m_breakpointHash;
     QMap<int, SV4Breakpoint> m_breakpoints;
     int m_breakpointIdCtr;
-    bool m_haveBreakpoints;
-
-    // script tracking
-    QList<QString> m_scriptIdStack;
 
-    // synchronization and jobs
-    mutable QMutex m_mutex;
-    QWaitCondition m_engineWaiter; // holds the engine untill the debugger resumes
-    QWaitCondition m_jobWaiter; // waits for the job to finish
-    CV4DebugJob* m_runningJob;
+    // compiled conditions are keyed by the breakpoint's address in m_breakpoints, guarded by m_mutex,
+    // dropped conditions are only deleted by the engine thread
+    QHash<const SV4Breakpoint*, SV4Condition> m_conditions;
+    QList<QV4::Script*> m_staleConditions;
+
+    // lock-free breakpoint lookup, m_breakpointLines is swapped by the debugger thread,
+    // the m_active* / m_last* members are only ever touched by the engine thread
+    QAtomicPointer<SV4BreakpointLines> m_breakpointLines;
+    mutable QList<SV4BreakpointLines*> m_retiredLines; // guarded by m_mutex
+    mutable SV4BreakpointLines* m_activeLines;
+    struct SFunctionLines
+    {
+        const QBitArray* lines = nullptr;
+        QV4::ExecutableCompilationUnit* unit = nullptr; // referenced, so the function's address is not reused while cached
+    };
+    mutable QHash<const QV4::Function*, SFunctionLines> m_functionLines; // resolved once per function and published table
+    mutable int m_functionLinesSwept; // size after the last sweep
+    mutable const QV4::Function* m_lastFunction;
+    mutable const QBitArray* m_lastLines;
+
+    // script tracking, ids are resolved through the engine's interning table
+    CV4EngineItf* m_scripts;
+    QVector<qint64> m_scriptIdStack;
+    const QV4::Function* m_lastScriptFunction;	// a freed function's address may be reused,
+    QString m_lastScriptSource;					// so the memo also checks the source and that no script was dropped
+    int m_lastScriptDrops;
+    qint64 m_lastScriptId;
+
+    // synchronization and jobs, the members alias the shared state
+    QSharedPointer<SV4AgentSync> m_sync;
+    QMutex& m_mutex;
+    QWaitCondition& m_engineWaiter;
+    QWaitCondition& m_jobWaiter;
+    QQueue<CV4JobBatchPtr>& m_jobQueue;
+    bool m_jobsScheduled; // runJob is posted to the engine's thread
+    QAtomicInt m_jobsPending; // checked by the instruction hook of a running engine
+    bool m_resumeRequested;
+    CV4DebugJob* m_runningJob; // engine thread only, set while a job executes
+    QAtomicInt m_detached; // no session uses the installed agent, its hooks return right away
 };
 
 #endif
\ No newline at end of file
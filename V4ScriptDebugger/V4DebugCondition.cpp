@@ -0,0 +1,210 @@
+/****************************************************************************
+**
+** Copyright (C) 2023-2025 David Xanatos (xanasoft.com) All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+**
+** To use the V4ScriptTools in a commercial project, you must obtain
+** an appropriate business use license.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#include "V4DebugCondition.h"
+#include <QRegularExpression>
+
+#include <private/qv4context_p.h>
+#include <private/qv4string_p.h>
+#include <private/qv4scopedvalue_p.h>
+
+#define CONDITION_OPERATOR	R"((===|!==|==|!=|<=|>=|<|>))"
+#define CONDITION_LITERAL	R"((-?\d+(?:\.\d+)?|"[^"\\]*"|'[^'\\]*'|true|false|null|undefined))"
+#define CONDITION_NAME		R"(([A-Za-z_$][\w$]*))"
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4DebugCondition
+//
+
+CV4DebugCondition::CV4DebugCondition(const QString& source)
+	: m_source(source)
+{
+	static const QRegularExpression hitCountRe(R"(^\s*\$hitCount\s*(?:%\s*(\d+)\s*)?)" CONDITION_OPERATOR R"(\s*(\d+)\s*$)");
+	static const QRegularExpression nameFirstRe(R"(^\s*)" CONDITION_NAME R"(\s*)" CONDITION_OPERATOR R"(\s*)" CONDITION_LITERAL R"(\s*$)");
+	static const QRegularExpression literalFirstRe(R"(^\s*)" CONDITION_LITERAL R"(\s*)" CONDITION_OPERATOR R"(\s*)" CONDITION_NAME R"(\s*$)");
+
+	QRegularExpressionMatch match = hitCountRe.match(source);
+	if (match.hasMatch()) {
+		m_modulo = match.captured(1).toInt();
+		if (!match.captured(1).isEmpty() && m_modulo == 0)
+			return; // x % 0 is NaN, leave it to JS
+		m_op = parseOperator(match.captured(2), false);
+		m_literal = eNumber;
+		m_number = match.captured(3).toDouble();
+		m_kind = eHitCount;
+		return;
+	}
+
+	QString name, op, literal;
+	bool swap = false;
+	if ((match = nameFirstRe.match(source)).hasMatch()) {
+		name = match.captured(1);
+		op = match.captured(2);
+		literal = match.captured(3);
+	}
+	else if ((match = literalFirstRe.match(source)).hasMatch()) {
+		literal = match.captured(1);
+		op = match.captured(2);
+		name = match.captured(3);
+		swap = true;
+	}
+	else
+		return;
+
+	if (name.startsWith('$') || !parseLiteral(literal))
+		return;
+	m_name = name;
+	m_op = parseOperator(op, swap);
+	m_kind = eCompare;
+}
+
+bool CV4DebugCondition::parseLiteral(const QString& literal)
+{
+	if (literal == "undefined")
+		m_literal = eUndefined;
+	else if (literal == "null")
+		m_literal = eNull;
+	else if (literal == "true" || literal == "false") {
+		m_literal = eBool;
+		m_number = literal == "true" ? 1 : 0;
+	}
+	else if (literal.startsWith('"') || literal.startsWith('\'')) {
+		m_literal = eString;
+		m_string = literal.mid(1, literal.length() - 2);
+	}
+	else {
+		bool ok;
+		m_number = literal.toDouble(&ok);
+		if (!ok)
+			return false;
+		m_literal = eNumber;
+	}
+	return true;
+}
+
+CV4DebugCondition::EOperator CV4DebugCondition::parseOperator(const QString& op, bool swap)
+{
+	// with the literal on the left side the relational operators are mirrored
+	if (op == "===")	return eStrictEq;
+	if (op == "!==")	return eStrictNe;
+	if (op == "==")		return eEq;
+	if (op == "!=")		return eNe;
+	if (op == "<=")		return swap ? eGe : eLe;
+	if (op == ">=")		return swap ? eLe : eGe;
+	if (op == "<")		return swap ? eGt : eLt;
+	/*op == ">"*/		return swap ? eLt : eGt;
+}
+
+template <typename T>
+bool CV4DebugCondition::compare(const T& l, const T& r) const
+{
+	switch (m_op) {
+	case eEq:
+	case eStrictEq:	return l == r;
+	case eNe:
+	case eStrictNe:	return !(l == r);
+	case eLt:		return l < r;
+	case eLe:		return l <= r;
+	case eGt:		return l > r;
+	case eGe:		return l >= r;
+	}
+	return false;
+}
+
+CV4DebugCondition::EResult CV4DebugCondition::compareValue(const QV4::Value& value) const
+{
+	bool sameType = false;
+	switch (m_literal) {
+	case eUndefined:	sameType = value.isUndefined(); break;
+	case eNull:			sameType = value.isNull(); break;
+	case eBool:			sameType = value.isBoolean(); break;
+	case eNumber:		sameType = value.isNumber(); break;
+	case eString:		sameType = value.isString(); break;
+	}
+
+	if (!sameType) {
+		// strict (in)equality never converts
+		if (m_op == eStrictEq)
+			return eFalse;
+		if (m_op == eStrictNe)
+			return eTrue;
+		// null == undefined
+		if ((m_literal == eNull || m_literal == eUndefined) && value.isNullOrUndefined())
+			return m_op == eEq ? eTrue : m_op == eNe ? eFalse : eFallback;
+		// anything else needs JS type conversion rules
+		return eFallback;
+	}
+
+	switch (m_literal) {
+	case eUndefined:
+	case eNull:
+		if (m_op == eEq || m_op == eStrictEq)
+			return eTrue;
+		if (m_op == eNe || m_op == eStrictNe)
+			return eFalse;
+		return eFallback;
+	case eBool:
+		return compare<double>(value.booleanValue() ? 1 : 0, m_number) ? eTrue : eFalse;
+	case eNumber:
+		return compare<double>(value.toNumber(), m_number) ? eTrue : eFalse;
+	case eString: // QString compares UTF-16 code units just like JS does
+		return compare<QString>(value.stringValue()->toQString(), m_string) ? eTrue : eFalse;
+	}
+	return eFallback;
+}
+
+CV4DebugCondition::EResult CV4DebugCondition::evaluate(QV4::ExecutionEngine* engine, int hitCount) const
+{
+	if (m_kind == eHitCount)
+		return compare<double>(m_modulo ? hitCount % m_modulo : hitCount, m_number) ? eTrue : eFalse;
+
+	if (m_kind != eCompare)
+		return eFallback;
+
+	//
+	// Note: only function and block scopes are searched, with, QML and global scopes
+	//	resolve names dynamically and are left to the JS evaluation
+	//
+
+	QV4::Scope scope(engine);
+	QV4::Scoped<QV4::ExecutionContext> ctxt(scope);
+	for (QV4::Heap::ExecutionContext* ctx = engine->currentContext()->d(); ctx; ctx = ctx->outer) {
+		if (ctx->type != QV4::Heap::ExecutionContext::Type_CallContext && ctx->type != QV4::Heap::ExecutionContext::Type_BlockContext)
+			break;
+
+		ctxt = ctx;
+		QV4::Heap::InternalClass* ic = ctxt->internalClass();
+		for (uint i = 0; i < ic->size; ++i) {
+#if QT_VERSION < QT_VERSION_CHECK(6, 8, 0)
+			if (ic->keyAt(i) != m_name)
+				continue;
+#else
+			QV4::Value keyVal = QV4::Value::fromReturnedValue(ic->keyAt(i));
+			QV4::String* keyStr = keyVal.stringValue();
+			if (!keyStr || keyStr->toQString() != m_name)
+				continue;
+#endif
+			return compareValue(static_cast<QV4::Heap::CallContext*>(ctx)->locals[i]);
+		}
+	}
+	return eFallback;
+}
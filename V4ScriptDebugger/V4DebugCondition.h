@@ -0,0 +1,100 @@
+/****************************************************************************
+**
+** Copyright (C) 2023-2025 David Xanatos (xanasoft.com) All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+**
+** To use the V4ScriptTools in a commercial project, you must obtain
+** an appropriate business use license.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#ifndef CV4DEBUGCONDITION_H
+#define CV4DEBUGCONDITION_H
+
+#include <QString>
+
+#include <private/qv4engine_p.h>
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4DebugCondition
+//
+// Recognizes trivial breakpoint conditions which can be decided without running any JS:
+//	<name> <op> <literal>, <literal> <op> <name>, $hitCount <op> <number> and $hitCount % <number> <op> <number>
+// where <name> is a local variable or argument of the hit frame, $hitCount counts how often the breakpoint was reached
+//
+
+class CV4DebugCondition
+{
+public:
+	enum EResult {
+		eFalse = 0,
+		eTrue,
+		eFallback	// could not be decided natively, evaluate the condition as JS
+	};
+
+	CV4DebugCondition() {}
+	explicit CV4DebugCondition(const QString& source);
+
+	const QString& source() const { return m_source; }
+	bool isNative() const { return m_kind != eScript; }
+
+	// must be called in the engine's thread
+	EResult evaluate(QV4::ExecutionEngine* engine, int hitCount) const;
+
+protected:
+	enum EKind {
+		eScript = 0,
+		eHitCount,
+		eCompare
+	};
+
+	enum EOperator {
+		eEq,
+		eNe,
+		eStrictEq,
+		eStrictNe,
+		eLt,
+		eLe,
+		eGt,
+		eGe
+	};
+
+	enum ELiteral {
+		eUndefined,
+		eNull,
+		eBool,
+		eNumber,
+		eString
+	};
+
+	bool parseLiteral(const QString& literal);
+	static EOperator parseOperator(const QString& op, bool swap);
+
+	template <typename T>
+	bool compare(const T& l, const T& r) const;
+	EResult compareValue(const QV4::Value& value) const;
+
+	QString m_source;
+	EKind m_kind = eScript;
+	EOperator m_op = eEq;
+	QString m_name;
+	int m_modulo = 0;
+
+	ELiteral m_literal = eUndefined;
+	double m_number = 0;
+	QString m_string;
+};
+
+#endif
@@ -21,73 +21,171 @@
 ****************************************************************************/
 
 #include "V4DebugHandler.h"
+#include "V4DebugProtocol.h"
 
 #include <private/qv4script_p.h>
 #include <private/qv4string_p.h>
 #include <private/qv4objectiterator_p.h>
 #include <private/qv4runtime_p.h>
 #include <private/qv4identifiertable_p.h>
+#include <private/qv4typedarray_p.h>
+#include <private/qv4functionobject_p.h>
+
+#include <QLocale>
+
+#include <limits>
+#include <cmath>
 
 
 void SV4Value::fromVariant(const QVariantMap& in)
 {
     QString strType = in["type"].toString();
     if (strType == "UndefinedValue")
-        type = "undefined";
+        type = eUndefined;
     else if (strType == "NullValue")
-        type = "null";
+        type = eNull;
     else if (strType == "BooleanValue") {
-        type = "boolean";
-        data = in["value"];
+        type = eBoolean;
+        boolean = in["value"].toBool();
     }
     else if (strType == "NumberValue") {
-        type = "number";
-        data = in["value"];
+        type = eNumber;
+        number = in["value"].toDouble();
     }
     else if (strType == "StringValue") {
-        type = "string";
-        data = in["value"];
+        type = eString;
+        string = in["value"].toString();
     }
     else if (strType == "ObjectValue") {
-        type = "object";
+        type = eObject;
+        count = -1;
         UV4Handle handle = { in["value"].toULongLong() };
         ref = handle.ref;
+        generation = handle.generation;
     }
 }
 
 QVariantMap SV4Value::toVariant() const
+{
+    return encode<SV4LegacyFormat>();
+}
+
+template <>
+QVariantMap SV4Value::encode<SV4LegacyFormat>() const
 {
     QVariantMap value;
-    if (type == "undefined")
+    switch (type)
+    {
+    case eUndefined:
         value["type"] = "UndefinedValue";
-    else if (type == "null")
+        break;
+    case eNull:
         value["type"] = "NullValue";
-    else if (type == "function")
-        value["type"] = "NoValue";
-    else if (type == "boolean") {
+        break;
+    case eBoolean:
         value["type"] = "BooleanValue";
-        value["value"] = data;
-    }
-    else if (type == "number") {
+        value["value"] = boolean;
+        break;
+    case eNumber:
         value["type"] = "NumberValue";
-        value["value"] = data;
-    }
-    else if (type == "string") {
+        value["value"] = number;
+        break;
+    case eString:
         value["type"] = "StringValue";
-        value["value"] = data;
-    }
-    else if (type == "object") {
+        value["value"] = string;
+        break;
+    case eObject:
+    case eArray:
         value["type"] = "ObjectValue";
-        UV4Handle handle = { 0 };
-        handle.type = UV4Handle::eObject;
-        handle.ref = ref;
-        value["value"] = handle.value;
-    }
-    else
+        value["value"] = handle();
+        break;
+    default: // functions can not be inspected by the QtScript debugger
         value["type"] = "NoValue";
+    }
     return value;
 }
 
+template <>
+QVariantMap SV4Value::encode<SV4CdpFormat>() const
+{
+    switch (type)
+    {
+    case eUndefined:
+        return QVariantMap{ {"type", "undefined"} };
+    case eNull:
+        return QVariantMap{ {"type", "object"}, {"subtype", "null"}, {"value", QVariant::fromValue(nullptr)} };
+    case eBoolean:
+        return QVariantMap{ {"type", "boolean"}, {"value", boolean} };
+    case eNumber:
+        // JSON has no NaN, infinities or negative zero
+        if (qIsNaN(number) || qIsInf(number) || (number == 0 && std::signbit(number)))
+            return QVariantMap{ {"type", "number"}, {"unserializableValue", toString()}, {"description", toString()} };
+        return QVariantMap{ {"type", "number"}, {"value", number}, {"description", toString()} };
+    case eString:
+        return QVariantMap{ {"type", "string"}, {"value", string} };
+    case eObject:
+        return QVariantMap{ {"type", "object"}, {"className", "Object"}, {"description", "Object"}, {"objectId", QString::number(handle())} };
+    case eArray:
+        return QVariantMap{ {"type", "object"}, {"subtype", "array"}, {"className", "Array"}, {"description", QString("Array(%1)").arg(count)}, {"objectId", QString::number(handle())} };
+    case eFunction:
+        if (ref == -1)
+            return QVariantMap{ {"type", "function"}, {"className", "Function"}, {"description", "function"} };
+        return QVariantMap{ {"type", "function"}, {"className", "Function"}, {"description", "function"}, {"objectId", QString::number(handle())} };
+    default:
+        return QVariantMap{ {"type", "symbol"}, {"description", "Symbol()"} };
+    }
+}
+
+QString SV4Value::toString() const
+{
+    switch (type)
+    {
+    case eBoolean:
+        return boolean ? QStringLiteral("true") : QStringLiteral("false");
+    case eNumber:
+        if (qIsNaN(number))
+            return QStringLiteral("NaN");
+        if (qIsInf(number))
+            return number > 0 ? QStringLiteral("Infinity") : QStringLiteral("-Infinity");
+        if (number == 0 && std::signbit(number))
+            return QStringLiteral("-0");
+        return QString::number(number, 'g', QLocale::FloatingPointShortest);
+    case eString:
+        return string;
+    case eObject:
+    case eArray:
+    case eFunction:
+        return count >= 0 ? QString::number(count) : QString();
+    default:
+        return QString();
+    }
+}
+
+quint64 SV4Value::handle() const
+{
+    UV4Handle handle = { 0 };
+    handle.type = UV4Handle::eObject;
+    handle.generation = generation;
+    handle.ref = ref;
+    return handle.value;
+}
+
+quint64 SV4Value::fingerprint() const
+{
+    // objects are compared by identity and count, everything else by value
+    quint64 hash = qHash(int(type));
+    switch (type)
+    {
+    case eBoolean:  return qHashMulti(hash, boolean);
+    case eNumber:   return qHashMulti(hash, number);
+    case eString:   return qHashMulti(hash, string);
+    case eObject:
+    case eArray:
+    case eFunction: return qHashMulti(hash, ref, generation, count);
+    default:        return hash;
+    }
+}
+
 void SV4Property::fromVariant(const QVariantMap& in)
 {
     name = in["name"].toString();
@@ -95,16 +193,36 @@ void SV4Property::fromVariant(const QVariantMap& in)
 }
 
 QVariantMap SV4Property::toVariant() const
+{
+    return encode<SV4LegacyFormat>();
+}
+
+template <>
+QVariantMap SV4Property::encode<SV4LegacyFormat>() const
 {
     QVariantMap out;
     out["name"] = name;
-    out["value"] = SV4Value::toVariant();
-    if (type != "function")
-        out["valueAsString"] = data.toString();
+    out["value"] = SV4Value::encode<SV4LegacyFormat>();
+    if (type != eFunction)
+        out["valueAsString"] = toString();
     out["flags"] = 0; // QScriptValue::PropertyFlag : ReadOnly = 0x00000001, Undeletable = 0x00000002
     return out;
 }
 
+template <>
+QVariantMap SV4Property::encode<SV4CdpFormat>() const
+{
+    // only own enumerable data properties are listed
+    return QVariantMap{
+        {"name", name},
+        {"value", SV4Value::encode<SV4CdpFormat>()},
+        {"writable", true},
+        {"configurable", true},
+        {"enumerable", true},
+        {"isOwn", true}
+    };
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4DebugHandler
 //
@@ -114,52 +232,72 @@ CV4DebugHandler::CV4DebugHandler(QV4::ExecutionEngine* engine, QObject* parent)
 {
     m_engine = engine;
     m_refArray.set(engine, engine->newArrayObject());
+    m_currentGroup = 0;
+    m_groupIds.insert(QString(), 0); // default group
+    m_weakRefs = false;
+    m_propertyCount = eFastCount;
 }
 
 const QV4::Object* CV4DebugHandler::getValue(const QV4::ScopedValue& value, SV4Value* result)
 {
-    QV4::Scope scope(m_engine);
-    QV4::ScopedValue type(scope, QV4::Runtime::TypeofValue::call(m_engine, value));
-    result->type = type->toQStringNoThrow();
-
+    // the type is told from the value itself, typeof would create a string for every value
     switch (value->type()) {
     case QV4::Value::Managed_Type:
         if (const QV4::ArrayObject* arr = value->as<QV4::ArrayObject>()) {
-            result->data = qint64(arr->getLength());
+            result->type = SV4Value::eArray;
+            result->count = qint64(arr->getLength());
             return arr;
         }
         else if (const QV4::Object* obj = value->as<QV4::Object>()) {
-            QV4::ObjectIterator it(scope, obj, QV4::ObjectIterator::EnumerableOnly);
-            QV4::PropertyAttributes attrs;
-            QV4::ScopedPropertyKey name(scope);
-            int count = 0;
-            for (;; count++) {
-                name = it.next(nullptr, &attrs);
-                if (!name->isValid())
-                    break;
+            result->type = obj->as<QV4::FunctionObject>() ? SV4Value::eFunction : SV4Value::eObject;
+            result->count = -1;
+            if (m_propertyCount == eFastCount)
+                result->count = propertyCountHint(obj);
+            else if (m_propertyCount == eExactCount) {
+                QV4::Scope scope(m_engine);
+                QV4::ObjectIterator it(scope, obj, QV4::ObjectIterator::EnumerableOnly);
+                QV4::PropertyAttributes attrs;
+                QV4::ScopedPropertyKey name(scope);
+                int count = 0;
+                for (;; count++) {
+                    name = it.next(nullptr, &attrs);
+                    if (!name->isValid())
+                        break;
+                }
+                result->count = count;
             }
-            result->data = count;
             return obj;
         }
-        else if (const QV4::String* str = value->as<QV4::String>())
-            result->data = str->toQString();
+        else if (const QV4::String* str = value->as<QV4::String>()) {
+            result->type = SV4Value::eString;
+            result->string = str->toQString();
+        }
+        else
+            result->type = SV4Value::eOther;
         return nullptr;
     case QV4::Value::Boolean_Type:
-        result->data = value->booleanValue();
+        result->type = SV4Value::eBoolean;
+        result->boolean = value->booleanValue();
         return nullptr;
     case QV4::Value::Integer_Type:
-        result->data = value->integerValue();
+        result->type = SV4Value::eNumber;
+        result->number = value->integerValue();
         return nullptr;
     case QV4::Value::Double_Type:
-        result->data = value->doubleValue();
+        result->type = SV4Value::eNumber;
+        result->number = value->doubleValue();
+        return nullptr;
+    case QV4::Value::Null_Type:
+        result->type = SV4Value::eNull;
         return nullptr;
     default:
     case QV4::Value::Empty_Type:
     case QV4::Value::Undefined_Type:
-    case QV4::Value::Null_Type:
+        result->type = SV4Value::eUndefined;
         return nullptr;
     }
 }
+
 QVector<SV4Property> CV4DebugHandler::getProperties(const QV4::Object* object)
 {
     QVector<SV4Property> properties;
@@ -175,16 +313,94 @@ QVector<SV4Property> CV4DebugHandler::getProperties(const QV4::Object* object)
             break;
         value = v;
 
-        SV4Property result;
-        QString key = name->toQStringNoThrow();
-        if (!key.isNull())
-            result.name = key;
+        properties.append(getProperty(name->toQStringNoThrow(), value));
+    }
+
+    return properties;
+}
+
+SV4Property CV4DebugHandler::getProperty(const QString& name, const QV4::ScopedValue& value)
+{
+    SV4Property result;
+    if (!name.isNull())
+        result.name = name;
+
+    getValue(value, &result);
+    if (value->isManaged() && !value->isString()) {
+        result.ref = addRef(value);
+        result.generation = refGeneration(result.ref);
+    }
+    return result;
+}
+
+qint64 CV4DebugHandler::propertyCountHint(const QV4::Object* object)
+{
+    // the members are laid out by the internal class and the indices kept in the array data,
+    // so no property needs to be visited
+    qint64 count = object->internalClass()->size;
+    if (const QV4::Heap::ArrayData* arrayData = object->arrayData())
+        count += arrayData->length();
+    return count;
+}
+
+qint64 CV4DebugHandler::indexedLength(const QV4::Object* object)
+{
+    // both report their length without running any script
+    if (object->as<QV4::ArrayObject>() || object->as<QV4::TypedArray>())
+        return object->getLength();
+    return -1;
+}
+
+QVector<SV4Property> CV4DebugHandler::getPropertyRange(const QV4::Object* object, int filter, qint64 offset, qint64 count)
+{
+    QVector<SV4Property> properties;
+
+    QV4::Scope scope(m_engine);
+    QV4::ScopedValue value(scope);
+    qint64 end = count < 0 ? std::numeric_limits<qint64>::max() : offset + count;
 
-        getValue(value, &result);
-        if (value->isManaged() && !value->isString())
-            result.ref = addRef(value);
+    qint64 length = filter == SV4Command::eIndexedProperties ? indexedLength(object) : -1;
+    if (length >= 0) {
+        for (qint64 i = offset; i < qMin(end, length); i++) {
+            value = object->get(uint(i));
+            properties.append(getProperty(QString::number(i), value));
+        }
+        return properties;
+    }
+
+    // the named properties of arrays are laid out by the internal class, the indexed storage is never walked
+    if (filter == SV4Command::eNamedProperties && indexedLength(object) >= 0) {
+        QV4::ScopedPropertyKey key(scope);
+        qint64 i = 0;
+        for (uint slot = 0; i < end && slot < object->internalClass()->size; slot++) { // a getter may add members
+            const QV4::Heap::InternalClass* ic = object->internalClass();
+            key = ic->nameMap.at(slot);
+            if (!key->isValid() || key->isSymbol() || !ic->propertyData.at(slot).isEnumerable())
+                continue; // setter slots of accessors have no key
+            if (i++ < offset)
+                continue;
 
-        properties.append(result);
+            value = object->get(key);
+            properties.append(getProperty(key->toQString(), value));
+        }
+        return properties;
+    }
+
+    // only the keys are enumerated, the values are read for the properties in range
+    QV4::ObjectIterator it(scope, object, QV4::ObjectIterator::EnumerableOnly);
+    QV4::PropertyAttributes attrs;
+    QV4::ScopedPropertyKey key(scope);
+    for (qint64 i = 0; i < end;) {
+        key = it.next(nullptr, &attrs);
+        if (!key->isValid())
+            break;
+        if ((filter == SV4Command::eIndexedProperties && !key->isArrayIndex()) || (filter == SV4Command::eNamedProperties && key->isArrayIndex()))
+            continue;
+        if (i++ < offset)
+            continue;
+
+        value = object->get(key);
+        properties.append(getProperty(key->toQString(), value));
     }
 
     return properties;
@@ -195,6 +411,7 @@ SV4Object CV4DebugHandler::getObject(const QV4::ScopedValue& value, uint ref)
     SV4Object result;
 
     result.ref = ref;
+    result.generation = refGeneration(ref);
     const QV4::Object* object = getValue(value, &result);
     if (object) {
         result.handle.type = UV4Handle::eObject;
@@ -213,43 +430,134 @@ SV4Object CV4DebugHandler::lookupRef(uint ref)
     return getObject(value, ref);
 }
 
-bool CV4DebugHandler::isValidRef(uint ref) const
+bool CV4DebugHandler::isValidRef(uint ref, uint generation) const
 {
-    QV4::Scope scope(m_engine);
-    QV4::ScopedObject refArray(scope, m_refArray.value());
-
-    return ref < refArray->getLength();
+    return ref < (uint)m_refSlots.size() 
+        && m_refSlots[ref].group != -1 
+        && m_refSlots[ref].generation == generation;
 }
 
 uint CV4DebugHandler::addRef(QV4::Value value)
 {
-    QV4::Scope scope(m_engine);
-    QV4::ScopedObject refArray(scope, m_refArray.value());
+    //
+    // Note: refs are only shared within a group, releasing one group never invalidates
+    //	a handle another group or the pause payload still holds
+    //
 
     // find and return already existing object
-    for (uint i = 0; i < refArray->getLength(); ++i) {
-        if (refArray->get(i) == value.rawValue())
-            return i;
+    auto I = m_refIndex.constFind(qMakePair(value.rawValue(), m_currentGroup));
+    if (I != m_refIndex.constEnd()) {
+        // a weakly referenced value may have been collected and its address reused
+        if (getValue(*I) == value.rawValue())
+            return *I;
+        freeRef(*I);
     }
 
-    quint8 hadException = m_engine->hasException;
-    m_engine->hasException = false; // ensure put works
+    // track new object, recycle released slots first
+    uint ref;
+    if (!m_freeRefs.isEmpty())
+        ref = m_freeRefs.takeLast();
+    else {
+        ref = m_refSlots.size();
+        m_refSlots.append(SRefSlot());
+    }
+
+    SRefSlot& slot = m_refSlots[ref];
+    slot.group = m_currentGroup;
+    slot.raw = value.rawValue();
+    slot.weak = m_weakRefs && value.isManaged();
+    if (slot.weak)
+        m_weakValues[ref].set(m_engine, value);
+    else {
+        QV4::Scope scope(m_engine);
+        QV4::ScopedObject refArray(scope, m_refArray.value());
 
-    // track new object
-    uint ref = refArray->getLength();
-    refArray->put(ref, value);
-    Q_ASSERT(refArray->getLength() - 1 == ref);
+        quint8 hadException = m_engine->hasException;
+        m_engine->hasException = false; // ensure the store works
 
-    m_engine->hasException = hadException;
+        refArray->arraySet(ref, value);
+
+        m_engine->hasException = hadException;
+    }
+    m_refIndex.insert(qMakePair(slot.raw, slot.group), ref);
 
     return ref;
 }
 
 QV4::ReturnedValue CV4DebugHandler::getValue(uint ref)
 {
+    Q_ASSERT(ref < (uint)m_refSlots.size());
+    if (m_refSlots[ref].weak) {
+        auto I = m_weakValues.constFind(ref);
+        return I != m_weakValues.constEnd() ? I->value() : QV4::Encode::undefined();
+    }
+
     QV4::Scope scope(m_engine);
     QV4::ScopedObject refArray(scope, m_refArray.value());
 
-    Q_ASSERT(ref < refArray->getLength());
-    return refArray->get(ref, nullptr);
+    return refArray->arrayData()->get(ref);
+}
+
+void CV4DebugHandler::setRefGroup(const QString& group)
+{
+    auto I = m_groupIds.find(group);
+    if (I == m_groupIds.end())
+        I = m_groupIds.insert(group, m_groupIds.size());
+    m_currentGroup = *I;
+}
+
+void CV4DebugHandler::freeRef(uint ref)
+{
+    //
+    // Note: this accesses the engine's heap, so it must run in the engine thread or while it is paused
+    //
+
+    SRefSlot& slot = m_refSlots[ref];
+
+    // keyed by the value it was created for, a dead weak value no longer tells
+    auto I = m_refIndex.find(qMakePair(slot.raw, slot.group));
+    if (I != m_refIndex.end() && *I == ref)
+        m_refIndex.erase(I);
+
+    if (slot.weak)
+        m_weakValues.remove(ref);
+    else {
+        QV4::Scope scope(m_engine);
+        QV4::ScopedObject refArray(scope, m_refArray.value());
+        refArray->arraySet(ref, QV4::Value::undefinedValue());
+    }
+
+    slot.group = -1;
+    slot.raw = 0;
+    slot.weak = false;
+    slot.generation = (slot.generation + 1) & 0xFFFFFF; // invalidates all handles to the old value
+    m_freeRefs.append(ref);
+}
+
+bool CV4DebugHandler::releaseRef(uint ref, uint generation)
+{
+    if (!isValidRef(ref, generation))
+        return false;
+    freeRef(ref);
+    return true;
+}
+
+void CV4DebugHandler::releaseGroup(const QString& group)
+{
+    int groupId = m_groupIds.value(group, -1);
+    if (groupId == -1)
+        return;
+
+    for (uint ref = 0; ref < (uint)m_refSlots.size(); ref++) {
+        if (m_refSlots[ref].group == groupId)
+            freeRef(ref);
+    }
+}
+
+void CV4DebugHandler::releaseAll()
+{
+    for (uint ref = 0; ref < (uint)m_refSlots.size(); ref++) {
+        if (m_refSlots[ref].group != -1)
+            freeRef(ref);
+    }
 }
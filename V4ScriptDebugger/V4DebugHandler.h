@@ -36,12 +36,13 @@ union UV4Handle
 		eValue = 0,
 		eScope,
 		eObject,
-		eThis
+		eThis,
+		eBucket				// a range of array indices, only known to the backend
 	};
 	struct {
 		quint32					// 32
 			type : 8,
-			unused : 24;
+			generation : 24;	// of the ref slot, stale handles are rejected
 		union {
 			struct {
 				short frame;	// 16
@@ -52,22 +53,60 @@ union UV4Handle
 	};							// 64
 };
 
+// the formats values are encoded in, see SV4Value::encode
+struct SV4LegacyFormat {};		// QtScript debugger values, e.g. {"type": "NumberValue", "value": 1}
+struct SV4CdpFormat {};			// CDP Runtime.RemoteObject and Runtime.PropertyDescriptor
+
 struct SV4Value
 {
-	SV4Value() : ref(-1) {}
+	SV4Value() : count(0), type(eUndefined), ref(-1), generation(0) {}
+
+	enum EType : quint8
+	{
+		eUndefined = 0,
+		eNull,
+		eBoolean,
+		eNumber,
+		eString,
+		eObject,
+		eArray,
+		eFunction,
+		eOther				// symbols
+	};
 
 	void fromVariant(const QVariantMap& in);
-    QVariantMap toVariant() const;
+    QVariantMap toVariant() const; // same as encode<SV4LegacyFormat>
+
+	template <typename TFormat>
+	QVariantMap encode() const;
+
+	QString toString() const;
+	quint64 handle() const; // of an object, array or function
+
+	// equal values have equal fingerprints, a collision only hides a change
+	quint64 fingerprint() const;
 
-	QString type;
-	QVariant data;
+	union {
+		bool boolean;
+		double number;
+		qint64 count;		// objects and functions the property count, arrays their length, -1 if not known
+	};
+	QString string;			// shares the engine's string data
+	EType type;
 	int ref;
+	uint generation;
 };
 
+template <> QVariantMap SV4Value::encode<SV4LegacyFormat>() const;
+template <> QVariantMap SV4Value::encode<SV4CdpFormat>() const;
+
 struct SV4Property : SV4Value
 {
 	void fromVariant(const QVariantMap& in);
-	QVariantMap toVariant() const;
+	QVariantMap toVariant() const; // same as encode<SV4LegacyFormat>
+
+	template <typename TFormat>
+	QVariantMap encode() const;
 
 	SV4Property() {}
 	SV4Property(const SV4Value& v, const QString n) 
@@ -76,6 +115,9 @@ struct SV4Property : SV4Value
 	QString name;
 };
 
+template <> QVariantMap SV4Property::encode<SV4LegacyFormat>() const;
+template <> QVariantMap SV4Property::encode<SV4CdpFormat>() const;
+
 struct SV4Object: SV4Value
 {
 	SV4Object() : handle{ 0 } {}
@@ -84,6 +126,21 @@ struct SV4Object: SV4Value
 	QVector<SV4Property>properties;
 };
 
+struct SV4ObjectSnapshot
+{
+	SV4ObjectSnapshot() : handle{ 0 } {}
+
+	struct SEntry
+	{
+		quint64 fingerprint;
+		int index;				// into names
+	};
+
+	UV4Handle			handle;
+	QHash<QString, SEntry> entries;
+	QVector<QString>	names;	// in property order
+};
+
 struct SV4ValueIterator
 {
 	SV4ValueIterator() : index(0) {}
@@ -108,18 +165,62 @@ public:
 	uint addRef(QV4::Value value);
 	QV4::ReturnedValue getValue(uint ref);
 
-    bool isValidRef(uint ref) const;
+    bool isValidRef(uint ref, uint generation) const;
+    uint refGeneration(uint ref) const { return ref < (uint)m_refSlots.size() ? m_refSlots[ref].generation : 0; }
 	SV4Object lookupRef(uint ref);
 
+	// new refs are tagged with the current object group, groups are released as a whole
+	void setRefGroup(const QString& group);
+	void setWeakRefs(bool weak) { m_weakRefs = weak; }
+	bool weakRefs() const { return m_weakRefs; }
+
+	// the data of an object value is its property count
+	enum EPropertyCount
+	{
+		eNoCount = 0,
+		eFastCount,		// from the object's layout, may include non enumerable members
+		eExactCount		// enumerates the properties of every object value
+	};
+	void setPropertyCount(EPropertyCount mode) { m_propertyCount = mode; }
+
+	bool releaseRef(uint ref, uint generation);
+	void releaseGroup(const QString& group);
+	void releaseAll();
+
 protected:
 	friend class CV4GetPropsJob;
+	friend class CV4GetPropertyRangeJob;
 	const QV4::Object* getValue(const QV4::ScopedValue& value, SV4Value* result);
+	SV4Property getProperty(const QString& name, const QV4::ScopedValue& value);
 	QVector<SV4Property> getProperties(const QV4::Object* object);
+	// up to count (-1 for all) properties passing the filter starting at offset,
+	// the indices of arrays and typed arrays are read directly without enumerating the object
+	QVector<SV4Property> getPropertyRange(const QV4::Object* object, int filter, qint64 offset, qint64 count);
+	static qint64 indexedLength(const QV4::Object* object); // -1 if the indices can not be read directly
+	static qint64 propertyCountHint(const QV4::Object* object);
 	SV4Object getObject(const QV4::ScopedValue& value, uint ref);
 
+	void freeRef(uint ref);
+
 private:
     QV4::ExecutionEngine* m_engine;
-    QV4::PersistentValue m_refArray;
+    QV4::PersistentValue m_refArray;	// keeps the referenced values alive
+    QHash<QPair<quint64, int>, uint> m_refIndex;	// (raw value, group) -> ref, each group holds its own refs
+
+    struct SRefSlot {
+        uint generation = 0;
+        int group = -1;					// -1 when the slot is free
+        bool weak = false;
+        quint64 raw = 0;				// the value it was created for, keys m_refIndex
+    };
+    QVector<SRefSlot> m_refSlots;
+    QVector<uint> m_freeRefs;
+    QHash<uint, QV4::WeakValue> m_weakValues;
+
+    QHash<QString, int> m_groupIds;
+    int m_currentGroup;
+    bool m_weakRefs;
+    EPropertyCount m_propertyCount;
 };
 
 #endif
\ No newline at end of file
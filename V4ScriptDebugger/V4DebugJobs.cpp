@@ -49,7 +49,7 @@ void CV4GetPropsJob::run()
 
     if (handle.type == UV4Handle::eObject)
     {
-        if (handler->isValidRef(handle.ref)) {
+        if (handler->isValidRef(handle.ref, handle.generation)) {
             result = handler->lookupRef(handle.ref);
             success = true;
         }
@@ -70,8 +70,7 @@ void CV4GetPropsJob::run()
                 QString name = keyStr ? keyStr->toQStringNoThrow() : QString();
 #endif
                 v = static_cast<QV4::Heap::CallContext*>(ctxt->d())->locals[i];
-                uint ref = handler->addRef(v);
-                result.properties.append(SV4Property(handler->getObject(v, ref), name));
+                result.properties.append(handler->getProperty(name, v)); // the locals themselves are not expanded
             }
             success = true;
         }
@@ -87,6 +86,36 @@ void CV4GetPropsJob::run()
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4GetPropertyRangeJob
+//
+
+CV4GetPropertyRangeJob::CV4GetPropertyRangeJob(CV4DebugHandler* handler, UV4Handle handle, int filter, qint64 offset, qint64 count, qint64 bucketSize) :
+    handler(handler), handle(handle), filter(filter), offset(offset), count(count), bucketSize(bucketSize), success(false), bucketed(false), length(-1)
+{
+}
+
+void CV4GetPropertyRangeJob::run()
+{
+    if (handle.type != UV4Handle::eObject || !handler->isValidRef(handle.ref, handle.generation))
+        return;
+
+    QV4::Scope scope(handler->engine());
+    QV4::ScopedValue value(scope, handler->getValue(handle.ref));
+    const QV4::Object* object = value->as<QV4::Object>();
+    if (!object)
+        return;
+
+    length = CV4DebugHandler::indexedLength(object);
+    if (filter == SV4Command::eAllProperties && count < 0 && bucketSize > 0 && length > bucketSize) {
+        result = handler->getPropertyRange(object, SV4Command::eNamedProperties, 0, -1);
+        bucketed = true;
+    }
+    else
+        result = handler->getPropertyRange(object, filter, offset, count);
+    success = true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4SetValueJob
 //
@@ -101,21 +130,23 @@ void CV4SetValueJob::run()
     QV4::Scope scope(handler->engine());
 
     QV4::ScopedValue v(scope);
-    if (value.type == "undefined")
+    if (value.type == SV4Value::eUndefined)
         v = QV4::Encode::undefined();
-    else if (value.type == "null")
+    else if (value.type == SV4Value::eNull)
         v = QV4::Encode::null();
-    else if (value.type == "boolean")
-        v = QV4::Encode(value.data.toBool());
-    else if (value.type == "number") 
-        v = QV4::Encode(value.data.toDouble());
-    else if (value.type == "string") 
-        v = handler->engine()->newString(value.data.toString());
-    else if (value.ref != -1)
+    else if (value.type == SV4Value::eBoolean)
+        v = QV4::Encode(value.boolean);
+    else if (value.type == SV4Value::eNumber) 
+        v = QV4::Encode(value.number);
+    else if (value.type == SV4Value::eString) 
+        v = handler->engine()->newString(value.string);
+    else if (value.ref != -1 && handler->isValidRef(value.ref, value.generation))
         v = handler->getValue(value.ref);
 
     if (handle.type == UV4Handle::eObject)
     {
+        if (!handler->isValidRef(handle.ref, handle.generation))
+            return;
         QV4::ScopedObject o(scope, handler->getValue(handle.ref));
         if (o->as<QV4::ArrayObject>() != NULL) {
             o->put(name.toInt(), v);
@@ -139,6 +170,33 @@ void CV4SetValueJob::run()
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ReleaseJob
+//
+
+CV4ReleaseJob::CV4ReleaseJob(CV4DebugHandler* handler, EMode mode, UV4Handle handle, const QString& group)
+    : handler(handler), mode(mode), handle(handle), group(group), success(false)
+{
+}
+
+void CV4ReleaseJob::run()
+{
+    switch (mode)
+    {
+    case eRef:
+        success = handle.type == UV4Handle::eObject && handler->releaseRef(handle.ref, handle.generation);
+        break;
+    case eGroup:
+        handler->releaseGroup(group);
+        success = true;
+        break;
+    case eAll:
+        handler->releaseAll();
+        success = true;
+        break;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4ScriptJob
 //
@@ -165,14 +223,16 @@ void CV4ScriptJob::run()
 
 QV4::ScopedValue CV4ScriptJob::exec(QV4::ExecutionEngine* engine, QV4::Scope& scope, const QString& program, int frameNr/*, int context*/)
 {
-    QV4::ScopedContext ctx(scope, engine->currentStackFrame ? engine->currentContext() : engine->scriptContext());
+    // frame -1 is the global scope with the global this, like an indirect eval, whatever function the engine is in
+    bool global = frameNr < 0;
+    QV4::ScopedContext ctx(scope, engine->currentStackFrame && !global ? engine->currentContext() : engine->scriptContext());
 
-    QV4::CppStackFrame* frame = CV4DebugAgent::findFrame(engine, frameNr);
+    QV4::CppStackFrame* frame = global ? nullptr : CV4DebugAgent::findFrame(engine, frameNr);
     if (frameNr > 0 && frame)
         ctx = frame->context();
 
     QV4::Script script(ctx, QV4::Compiler::ContextType::Eval, program);
-    script.strictMode = (frame ? frame->v4Function : engine->globalCode)->isStrict();
+    script.strictMode = !global && (frame ? frame->v4Function : engine->globalCode)->isStrict();
     script.inheritContext = true;
     script.parse();
     QV4::ScopedValue result(scope);
@@ -202,3 +262,51 @@ void CV4RunScriptJob::handleResult(QV4::ScopedValue& value)
         exception = value->toQStringNoThrow();
     result = handler->lookupRef(handler->addRef(value));
 }
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4CallFramesJob
+//
+
+CV4CallFramesJob::CV4CallFramesJob(CV4DebugHandler* handler, int from, int count) :
+    handler(handler), from(from), count(count)
+{
+}
+
+void CV4CallFramesJob::run()
+{
+    QV4::Scope scope(handler->engine());
+    QV4::ScopedValue v(scope);
+
+    QV4::CppStackFrame* frame = CV4DebugAgent::findFrame(handler->engine(), from);
+    for (int frameNr = from; frame && (count <= 0 || frameNr < from + count); frameNr++) {
+        SV4CallFrame callFrame;
+        callFrame.index = frameNr;
+        callFrame.functionName = frame->function();
+        callFrame.lineNumber = frame->lineNumber();
+        sources.append(frame->source());
+
+        v = frame->thisObject();
+        UV4Handle This = { 0 };
+        This.type = UV4Handle::eObject;
+        This.ref = handler->addRef(v);
+        This.generation = handler->refGeneration(This.ref);
+        callFrame.thisObject = This.value;
+
+        QV4::Heap::ExecutionContext* ctx = frame->context()->d();
+        for (int i = 0; ctx; ctx = ctx->outer, i++) {
+            UV4Handle Scope = { 0 };
+            Scope.type = UV4Handle::eScope;
+            Scope.frame = frameNr;
+            Scope.scope = i;
+            callFrame.scopeChain.append(SV4CallFrame::SScope{ CV4DebugAgent::scopeType(ctx), Scope.value });
+        }
+
+        frames.append(callFrame);
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        frame = frame->parent;
+#else
+        frame = frame->parentFrame();
+#endif
+    }
+}
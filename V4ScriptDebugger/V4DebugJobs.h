@@ -24,6 +24,7 @@
 #define CV4DEBUGJOBS_H
 
 #include "V4DebugHandler.h"
+#include "V4DebugProtocol.h"
 
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4DebugJob
@@ -56,6 +57,36 @@ public:
     const SV4Object& returnValue() const { return result; }
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4GetPropertyRangeJob
+//
+// Reads a slice of an object's properties, when all properties of an array longer than the
+// bucket size are requested only the named ones are read, the caller splits the indices into buckets
+//
+
+class CV4GetPropertyRangeJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+    UV4Handle handle;
+    int filter;
+    qint64 offset;
+    qint64 count;
+    qint64 bucketSize;
+    bool success;
+    bool bucketed;
+    qint64 length;
+    QVector<SV4Property> result;
+
+public:
+    CV4GetPropertyRangeJob(CV4DebugHandler* handler, UV4Handle handle, int filter, qint64 offset, qint64 count, qint64 bucketSize = 0);
+    void run() override;
+
+    bool wasSuccessful() const { return success; }
+    bool isBucketed() const { return bucketed; }
+    qint64 indexedLength() const { return length; }
+    const QVector<SV4Property>& returnValue() const { return result; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4SetValueJob
 //
@@ -75,6 +106,33 @@ public:
     bool wasSuccessful() const { return success; }
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ReleaseJob
+//
+
+class CV4ReleaseJob : public CV4DebugJob
+{
+public:
+    enum EMode {
+        eRef,
+        eGroup,
+        eAll
+    };
+
+private:
+    class CV4DebugHandler* handler;
+    EMode mode;
+    UV4Handle handle;
+    QString group;
+    bool success;
+
+public:
+    CV4ReleaseJob(CV4DebugHandler* handler, EMode mode, UV4Handle handle = { 0 }, const QString& group = QString());
+    void run() override;
+
+    bool wasSuccessful() const { return success; }
+};
+
 ////////////////////////////////////////////////////////////////////////////////////
 // CV4ScriptJob
 //
@@ -84,7 +142,7 @@ class CV4ScriptJob : public CV4DebugJob
     QV4::ExecutionEngine* engine;
     int frameNr;
     //int context;
-    const QString& program;
+    QString program;
     bool resultIsException;
 
 public:
@@ -118,4 +176,28 @@ public:
     const SV4Object& returnValue() const { return result; }
 };
 
+////////////////////////////////////////////////////////////////////////////////////
+// CV4CallFramesJob
+//
+// Captures the frames, locations, this objects and scope chains of the paused engine in one go,
+// the script ids are left to the caller which resolves them from frameSources(),
+// the stack is only walked up to the last requested frame
+//
+
+class CV4CallFramesJob : public CV4DebugJob
+{
+    class CV4DebugHandler* handler;
+    int from;
+    int count;
+    QVector<SV4CallFrame> frames;
+    QStringList sources;
+
+public:
+    CV4CallFramesJob(CV4DebugHandler* handler, int from, int count);
+    void run() override;
+
+    QVector<SV4CallFrame>& callFrames() { return frames; }
+    const QStringList& frameSources() const { return sources; }
+};
+
 #endif
\ No newline at end of file
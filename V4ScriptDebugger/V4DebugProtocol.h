@@ -0,0 +1,557 @@
+/****************************************************************************
+**
+** Copyright (C) 2023-2025 David Xanatos (xanasoft.com) All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+**
+** To use the V4ScriptTools in a commercial project, you must obtain
+** an appropriate business use license.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#ifndef V4DEBUGPROTOCOL_H
+#define V4DEBUGPROTOCOL_H
+
+#include <QString>
+#include <QVariant>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QMetaType>
+
+#include <functional>
+
+//
+// Typed form of the V4 debugger protocol, used between in-process frontends and CV4ScriptDebuggerBackend.
+// toVariant/fromVariant convert to and from the QVariant wire form, which is only needed by the
+// NeoScriptTools frontend and by transports crossing a process boundary.
+//
+// Note: this header only depends on QtCore so frontends can use it without linking the backend
+//
+
+////////////////////////////////////////////////////////////////////////////////////
+// SV4Command
+//
+
+struct SV4Command
+{
+	enum EType {
+		eUnknown = 0,
+
+		eInterrupt,
+		eContinue,
+		eStepInto,
+		eStepOver,
+		eStepOut,
+		eResume,
+		eRunToLocation,
+		eRunToLocationByID,
+		eEvaluate,
+		eForceReturn,
+
+		eSetBreakpoint,
+		eDeleteBreakpoint,
+		eDeleteAllBreakpoints,
+		eGetBreakpoints,
+		eGetBreakpointData,
+		eSetBreakpointData,
+
+		eGetScriptData,
+		eResolveScript,
+		eGetScripts,
+		eScriptsCheckpoint,
+		eGetScriptsDelta,
+
+		eGetBacktrace,
+		eGetContextCount,
+		eGetContextInfo,
+		eGetContextState,
+		eGetContextID,
+		eContextsCheckpoint,
+		eGetThisObject,
+		eReleaseObject,
+		eReleaseObjectGroup,
+		eGetScopeChain,
+		eGetActivationObject,
+		eGetPropertyExpressionValue,
+		eGetCompletions,
+
+		eNewScriptObjectSnapshot,
+		eScriptObjectSnapshotCapture,
+		eDeleteScriptObjectSnapshot,
+		eScriptValueToString,
+		eNewScriptValueIterator,
+		eGetPropertiesByIterator,
+		eDeleteScriptValueIterator,
+		eSetScriptValueProperty,
+		eClearExceptions,
+
+		eGetCallFrames,
+		eGetPropertyRange,
+
+		eTypeCount
+	};
+
+	SV4Command(EType type = eUnknown) : type(type) {}
+
+	enum EPropertyFilter
+	{
+		eAllProperties = 0,
+		eIndexedProperties,		// array indices, read directly from arrays and typed arrays
+		eNamedProperties
+	};
+
+	static const char* typeName(EType type)
+	{
+		static const char* names[eTypeCount] = {
+			"",
+			"Interrupt", "Continue", "StepInto", "StepOver", "StepOut", "Resume", "RunToLocation", "RunToLocationByID", "Evaluate", "ForceReturn",
+			"SetBreakpoint", "DeleteBreakpoint", "DeleteAllBreakpoints", "GetBreakpoints", "GetBreakpointData", "SetBreakpointData",
+			"GetScriptData", "ResolveScript", "GetScripts", "ScriptsCheckpoint", "GetScriptsDelta",
+			"GetBacktrace", "GetContextCount", "GetContextInfo", "GetContextState", "GetContextID", "ContextsCheckpoint",
+			"GetThisObject", "ReleaseObject", "ReleaseObjectGroup", "GetScopeChain", "GetActivationObject", "GetPropertyExpressionValue", "GetCompletions",
+			"NewScriptObjectSnapshot", "ScriptObjectSnapshotCapture", "DeleteScriptObjectSnapshot",
+			"ScriptValueToString", "NewScriptValueIterator", "GetPropertiesByIterator", "DeleteScriptValueIterator", "SetScriptValueProperty", "ClearExceptions",
+			"GetCallFrames", "GetPropertyRange"
+		};
+		return (type > eUnknown && type < eTypeCount) ? names[type] : "";
+	}
+
+	static EType typeFromName(const QString& name)
+	{
+		static const QHash<QString, EType> types = []() {
+			QHash<QString, EType> types;
+			for (int i = eUnknown + 1; i < eTypeCount; i++)
+				types.insert(QString::fromLatin1(typeName((EType)i)), (EType)i);
+			return types;
+		}();
+		return types.value(name, eUnknown);
+	}
+
+	inline QVariantMap toVariant() const;
+	static inline SV4Command fromVariant(const QVariantMap& in);
+
+	EType type;
+
+	// attributes, each command type only uses its own
+	int contextIndex = 0;
+	int count = 0;				// GetCallFrames, number of frames starting at contextIndex, GetPropertyRange, -1 for all, GetPropertiesByIterator, 0 for all
+	int pauseId = 0;			// GetCallFrames, the pause event the frames belong to, 0 for the current pause
+	int offset = 0;				// GetPropertyRange, the first index or the number of named properties to skip
+	int filter = eAllProperties;	// GetPropertyRange
+	bool cdpValues = false;		// GetPropertyRange, CDP property descriptors instead of QtScript debugger values
+	qint64 scriptId = -1;
+	QString fileName;
+	int lineNumber = 0;
+	QString program;
+	int timeout = 0;			// Evaluate, ms until the evaluation is interrupted, 0 uses the backend's budget
+	bool throwOnSideEffect = false;	// Evaluate, best effort, refuses programs which look like they may have side effects
+	QString objectGroup;
+	quint64 objectId = 0;		// ReleaseObject, the handle of the scriptValue for the snapshot, iterator and property commands
+	int breakpointId = -1;
+	QVariantMap breakpointData;
+	int snapshotId = 0;
+	int iteratorId = 0;
+	QString name;				// SetScriptValueProperty
+	QVariantMap value;			// SetScriptValueProperty
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// SV4Result
+//
+
+struct SV4Result
+{
+	inline QVariantMap toVariant() const;
+	static inline SV4Result fromVariant(const QVariantMap& in);
+
+	bool isError() const { return !error.isEmpty(); }
+
+	QVariant result;
+	QString type;				// QtScript type name of the result, e.g. "QScriptDebuggerValue"
+	QString error;
+	bool async = false;			// the outcome is reported by an event
+	int moreFrames = 0;			// GetBacktrace, frames past the listed ones
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// SV4CallFrame
+//
+
+struct SV4CallFrame
+{
+	struct SScope
+	{
+		QString type;			// CallContext, BlockContext, WithContext, QmlContext or GlobalContext
+		quint64 object = 0;		// scope handle
+	};
+
+	inline QVariantMap toVariant() const;
+	static inline SV4CallFrame fromVariant(const QVariantMap& in);
+
+	int index = 0;				// the contextIndex of the frame
+	QString functionName;
+	qint64 scriptId = -1;
+	QString fileName;
+	int lineNumber = 0;
+	int columnNumber = 0;
+	quint64 thisObject = 0;		// object handle
+	QVector<SScope> scopeChain;	// innermost first
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// SV4Event
+//
+
+struct SV4Event
+{
+	enum EType {
+		eUnknown = 0,
+
+		// pause events
+		eInterrupted,
+		eBreakpoint,
+		eSteppingFinished,
+		eLocationReached,
+		eDebuggerInvocationRequest,
+		eException,
+
+		eInlineEvalFinished,
+		eTrace,
+
+		eTypeCount
+	};
+
+	SV4Event(EType type = eUnknown) : type(type) {}
+
+	static const char* typeName(EType type)
+	{
+		static const char* names[eTypeCount] = {
+			"",
+			"Interrupted", "Breakpoint", "SteppingFinished", "LocationReached", "DebuggerInvocationRequest", "Exception",
+			"InlineEvalFinished", "Trace"
+		};
+		return (type > eUnknown && type < eTypeCount) ? names[type] : "";
+	}
+
+	static EType typeFromName(const QString& name)
+	{
+		for (int i = eUnknown + 1; i < eTypeCount; i++) {
+			if (name == QLatin1String(typeName((EType)i)))
+				return (EType)i;
+		}
+		return eUnknown;
+	}
+
+	bool isPause() const { return type >= eInterrupted && type <= eException; }
+
+	inline QVariantMap toVariant() const;
+	static inline SV4Event fromVariant(const QVariantMap& in);
+
+	EType type;
+
+	// location of pause events
+	qint64 scriptId = -1;
+	QString fileName;
+	int lineNumber = 0;
+	int columnNumber = 0;
+	int breakpointId = -1;		// eBreakpoint
+
+	// exceptions, evaluation results and traces
+	QString message;			// null if the exception could not be converted to a string
+	QVariant value;
+	bool hasExceptionHandler = false;
+	bool isNestedEvaluate = false;
+
+	// pause events, only filled in when the backend has a paused frame limit
+	QVector<SV4CallFrame> callFrames;
+	int frameCount = 0;			// of the whole stack, frames past callFrames can be fetched with GetCallFrames
+	int pauseId = 0;			// passed with GetCallFrames, so a late request does not get the frames of a later pause
+};
+
+Q_DECLARE_METATYPE(SV4Command)
+Q_DECLARE_METATYPE(SV4Result)
+Q_DECLARE_METATYPE(SV4Event)
+
+// synchronous typed call into the backend, the counterpart of the QVariant based BackendSyncCall
+using V4CommandCall = std::function<SV4Result(int id, const SV4Command& command)>;
+
+////////////////////////////////////////////////////////////////////////////////////
+// wire form
+//
+
+QVariantMap SV4Command::toVariant() const
+{
+	QVariantMap attributes;
+	switch (type)
+	{
+	case eRunToLocation:
+		attributes["fileName"] = fileName;
+		attributes["lineNumber"] = lineNumber;
+		break;
+	case eRunToLocationByID:
+		attributes["scriptId"] = scriptId;
+		attributes["lineNumber"] = lineNumber;
+		break;
+	case eEvaluate:
+		attributes["contextIndex"] = contextIndex;
+		attributes["fileName"] = fileName;
+		attributes["lineNumber"] = lineNumber;
+		attributes["program"] = program;
+		if (timeout > 0)
+			attributes["timeout"] = timeout;
+		if (throwOnSideEffect)
+			attributes["throwOnSideEffect"] = true;
+		if (!objectGroup.isEmpty())
+			attributes["objectGroup"] = objectGroup;
+		break;
+	case eSetBreakpoint:
+		attributes["breakpointData"] = breakpointData;
+		break;
+	case eSetBreakpointData:
+		attributes["breakpointData"] = breakpointData;
+		attributes["breakpointId"] = breakpointId;
+		break;
+	case eDeleteBreakpoint:
+	case eGetBreakpointData:
+		attributes["breakpointId"] = breakpointId;
+		break;
+	case eGetScriptData:
+		attributes["scriptId"] = scriptId;
+		break;
+	case eResolveScript:
+		attributes["fileName"] = fileName;
+		break;
+	case eGetContextInfo:
+	case eGetContextState:
+	case eGetContextID:
+	case eGetThisObject:
+	case eGetScopeChain:
+	case eGetActivationObject:
+		attributes["contextIndex"] = contextIndex;
+		break;
+	case eGetBacktrace:
+	case eGetCallFrames:
+		attributes["contextIndex"] = contextIndex;
+		attributes["count"] = count;
+		if (pauseId)
+			attributes["pauseId"] = pauseId;
+		break;
+	case eReleaseObject:
+		attributes["objectId"] = objectId;
+		break;
+	case eGetPropertyRange:
+		attributes["objectId"] = objectId;
+		attributes["filter"] = filter;
+		attributes["offset"] = offset;
+		attributes["count"] = count;
+		attributes["cdpValues"] = cdpValues;
+		break;
+	case eReleaseObjectGroup:
+		attributes["objectGroup"] = objectGroup;
+		break;
+	case eScriptObjectSnapshotCapture:
+		attributes["snapshotId"] = snapshotId;
+		Q_FALLTHROUGH();
+	case eScriptValueToString:
+	case eNewScriptValueIterator:
+		attributes["scriptValue"] = QVariantMap{ {"type", "ObjectValue"}, {"value", objectId} };
+		break;
+	case eDeleteScriptObjectSnapshot:
+		attributes["snapshotId"] = snapshotId;
+		break;
+	case eGetPropertiesByIterator:
+		attributes["iteratorId"] = iteratorId;
+		attributes["count"] = count;
+		break;
+	case eDeleteScriptValueIterator:
+		attributes["iteratorId"] = iteratorId;
+		break;
+	case eSetScriptValueProperty:
+		attributes["scriptValue"] = QVariantMap{ {"type", "ObjectValue"}, {"value", objectId} };
+		attributes["name"] = name;
+		attributes["subordinateScriptValue"] = value;
+		break;
+	default:
+		break;
+	}
+
+	QVariantMap out;
+	out["type"] = QString::fromLatin1(typeName(type));
+	if (!attributes.isEmpty())
+		out["attributes"] = attributes;
+	return out;
+}
+
+SV4Command SV4Command::fromVariant(const QVariantMap& in)
+{
+	SV4Command command(typeFromName(in.value("type").toString()));
+
+	const QVariantMap attributes = in.value("attributes").toMap();
+	for (auto I = attributes.constBegin(); I != attributes.constEnd(); ++I)
+	{
+		const QString& key = I.key();
+		if (key == "contextIndex")					command.contextIndex = I.value().toInt();
+		else if (key == "count")					command.count = I.value().toInt();
+		else if (key == "pauseId")					command.pauseId = I.value().toInt();
+		else if (key == "offset")					command.offset = I.value().toInt();
+		else if (key == "filter")					command.filter = I.value().toInt();
+		else if (key == "cdpValues")				command.cdpValues = I.value().toBool();
+		else if (key == "scriptId")					command.scriptId = I.value().toLongLong();
+		else if (key == "fileName")					command.fileName = I.value().toString();
+		else if (key == "lineNumber")				command.lineNumber = I.value().toInt();
+		else if (key == "program")					command.program = I.value().toString();
+		else if (key == "timeout")					command.timeout = I.value().toInt();
+		else if (key == "throwOnSideEffect")		command.throwOnSideEffect = I.value().toBool();
+		else if (key == "objectGroup")				command.objectGroup = I.value().toString();
+		else if (key == "objectId")					command.objectId = I.value().toULongLong();
+		else if (key == "scriptValue")				command.objectId = I.value().toMap().value("value").toULongLong();
+		else if (key == "breakpointId")				command.breakpointId = I.value().toInt();
+		else if (key == "breakpointData")			command.breakpointData = I.value().toMap();
+		else if (key == "snapshotId")				command.snapshotId = I.value().toInt();
+		else if (key == "iteratorId")				command.iteratorId = I.value().toInt();
+		else if (key == "name")						command.name = I.value().toString();
+		else if (key == "subordinateScriptValue")	command.value = I.value().toMap();
+	}
+	return command;
+}
+
+QVariantMap SV4Result::toVariant() const
+{
+	QVariantMap out;
+	if (result.isValid())
+		out["result"] = result;
+	if (!type.isEmpty())
+		out["type"] = type;
+	if (!error.isEmpty())
+		out["error"] = error;
+	if (async)
+		out["async"] = true;
+	if (moreFrames)
+		out["moreFrames"] = moreFrames;
+	return out;
+}
+
+SV4Result SV4Result::fromVariant(const QVariantMap& in)
+{
+	SV4Result result;
+	result.result = in.value("result");
+	result.type = in.value("type").toString();
+	result.error = in.value("error").toString();
+	result.async = in.value("async").toBool();
+	result.moreFrames = in.value("moreFrames").toInt();
+	return result;
+}
+
+QVariantMap SV4CallFrame::toVariant() const
+{
+	QVariantList scopes;
+	for (const SScope& scope : scopeChain)
+		scopes.append(QVariantMap{ {"type", scope.type}, {"object", scope.object} });
+
+	QVariantMap out;
+	out["index"] = index;
+	out["functionName"] = functionName;
+	out["scriptId"] = scriptId;
+	out["fileName"] = fileName;
+	out["lineNumber"] = lineNumber;
+	out["columnNumber"] = columnNumber;
+	out["thisObject"] = thisObject;
+	out["scopeChain"] = scopes;
+	return out;
+}
+
+SV4CallFrame SV4CallFrame::fromVariant(const QVariantMap& in)
+{
+	SV4CallFrame frame;
+	frame.index = in.value("index").toInt();
+	frame.functionName = in.value("functionName").toString();
+	frame.scriptId = in.value("scriptId", -1).toLongLong();
+	frame.fileName = in.value("fileName").toString();
+	frame.lineNumber = in.value("lineNumber").toInt();
+	frame.columnNumber = in.value("columnNumber").toInt();
+	frame.thisObject = in.value("thisObject").toULongLong();
+	for (const QVariant& var : in.value("scopeChain").toList()) {
+		QVariantMap scope = var.toMap();
+		frame.scopeChain.append(SScope{ scope.value("type").toString(), scope.value("object").toULongLong() });
+	}
+	return frame;
+}
+
+QVariantMap SV4Event::toVariant() const
+{
+	QVariantMap attributes;
+	if (isPause())
+	{
+		if (type == eBreakpoint)
+			attributes["breakPointId"] = breakpointId;
+		attributes["scriptId"] = scriptId;
+		attributes["fileName"] = fileName;
+		attributes["lineNumber"] = lineNumber;
+		attributes["columnNumber"] = columnNumber;
+		if (type == eException)
+		{
+			if (!message.isNull())
+				attributes["message"] = message;
+			if (value.isValid())
+				attributes["value"] = value;
+			attributes["hasExceptionHandler"] = hasExceptionHandler;
+		}
+		if (!callFrames.isEmpty())
+		{
+			QVariantList frames;
+			for (const SV4CallFrame& frame : callFrames)
+				frames.append(frame.toVariant());
+			attributes["callFrames"] = frames;
+			attributes["frameCount"] = frameCount;
+			attributes["pauseId"] = pauseId;
+		}
+	}
+	else if (type == eInlineEvalFinished)
+	{
+		attributes["value"] = value;
+		attributes["isNestedEvaluate"] = isNestedEvaluate;
+		attributes["message"] = message;
+	}
+	else if (type == eTrace)
+		attributes["message"] = message;
+
+	QVariantMap out;
+	out["type"] = QString::fromLatin1(typeName(type));
+	out["attributes"] = attributes;
+	return out;
+}
+
+SV4Event SV4Event::fromVariant(const QVariantMap& in)
+{
+	SV4Event event(typeFromName(in.value("type").toString()));
+
+	const QVariantMap attributes = in.value("attributes").toMap();
+	event.scriptId = attributes.value("scriptId", -1).toLongLong();
+	event.fileName = attributes.value("fileName").toString();
+	event.lineNumber = attributes.value("lineNumber").toInt();
+	event.columnNumber = attributes.value("columnNumber").toInt();
+	event.breakpointId = attributes.value("breakPointId", -1).toInt();
+	event.message = attributes.value("message").toString();
+	event.value = attributes.value("value");
+	event.hasExceptionHandler = attributes.value("hasExceptionHandler").toBool();
+	event.isNestedEvaluate = attributes.value("isNestedEvaluate").toBool();
+	for (const QVariant& frame : attributes.value("callFrames").toList())
+		event.callFrames.append(SV4CallFrame::fromVariant(frame.toMap()));
+	event.frameCount = attributes.value("frameCount").toInt();
+	event.pauseId = attributes.value("pauseId").toInt();
+	return event;
+}
+
+#endif
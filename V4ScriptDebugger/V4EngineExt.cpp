@@ -31,6 +31,10 @@
 #include <private/qqmldebugservice_p.h>
 #include <private/qv4qobjectwrapper_p.h>
 #include <private/qjsvalue_p.h>
+#include <private/qv4function_p.h>
+#include <private/qv4executablecompilationunit_p.h>
+
+#include <QThread>
 
 static QMutex g_engineMutex;
 static QMap<void*, CV4EngineExt*> g_engineMap;
@@ -48,6 +52,10 @@ static QV4::ReturnedValue evalCall(const QV4::FunctionObject* b, const QV4::Valu
 CV4EngineExt::CV4EngineExt(QObject* parent) 
     : QJSEngine(parent)
 {
+    // no limits unless enabled, without an attached agent live functions can not be told apart
+    m_MaxDynamicScripts = 0;
+    m_MaxDynamicBytes = 0;
+
     QV4::Scope scope(handle());
 
     // provide a print function to write to console
@@ -63,28 +71,325 @@ CV4EngineExt::CV4EngineExt(QObject* parent)
 
 CV4EngineExt::~CV4EngineExt()
 {
+    for (auto I = m_Scripts.begin(); I != m_Scripts.end(); ++I) {
+        if (I->Unit)
+            I->Unit->release();
+    }
+
     QMutexLocker locker(&g_engineMutex);
     g_engineMap.remove(handle());
 }
 
 QJSValue CV4EngineExt::evaluateScript(const QString& program, const QString& fileName, int lineNumber)
 {
-    QJSValue ret = QJSEngine::evaluate(program, trackScript(program, fileName, lineNumber), lineNumber);
+    qint64 scriptId;
+    QString FileName = trackScript(program, fileName, lineNumber, &scriptId);
+    m_Evaluating.append(scriptId);
+    QJSValue ret = QJSEngine::evaluate(program, FileName, lineNumber);
+    m_Evaluating.removeLast();
     emit evaluateFinished(ret);
     return ret;
 }
 
-QString CV4EngineExt::trackScript(const QString& program, const QString& fileName, int lineNumber)
+QString CV4EngineExt::trackScript(const QString& program, const QString& fileName, int lineNumber, qint64* pScriptId)
 {
     QString Name = QUrl(fileName).fileName();
+    bool dynamic = isDynamicScript(Name);
+
+    // the same dynamic code is evaluated over and over again, keep only one copy
+    if (dynamic) {
+        auto I = m_DynamicSources.constFind(program);
+        if (I != m_DynamicSources.constEnd()) {
+            const SScript& s = *m_Scripts.constFind(*I);
+            if (s.BaseName == Name && s.LineNumber == lineNumber) {
+                auto L = m_DynamicLruPos.constFind(*I);
+                if (L != m_DynamicLruPos.constEnd()) // mark as most recently used
+                    m_DynamicLru.splice(m_DynamicLru.end(), m_DynamicLru, *L);
+                if (pScriptId) *pScriptId = *I;
+                return s.Name;
+            }
+        }
+    }
+
+    // continue from the last suffix used for this name, names of dropped scripts are never reused
     QString FileName = Name;
-    for (int i = 0; m_ScriptIDs.contains(FileName.toLower());)
-        FileName = Name + " (" + QString::number(++i) + ")";
-    m_ScriptIDs.insert(FileName.toLower(), m_Scripts.count());
-    m_Scripts.append(SScript{ FileName, lineNumber, program });
+    auto S = m_NameSuffixes.find(Name.toLower());
+    if (S == m_NameSuffixes.end())
+        S = m_NameSuffixes.insert(Name.toLower(), 0);
+    else
+        FileName = Name + " (" + QString::number(++*S) + ")";
+    while (m_ScriptIDs.contains(FileName.toLower()))
+        FileName = Name + " (" + QString::number(++*S) + ")";
+
+    qint64 scriptId = m_Registry.count();
+    m_ScriptIDs.insert(FileName.toLower(), scriptId);
+    m_ScriptNames.insert(FileName, scriptId);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    m_ScriptSources.insert(FileName, scriptId);
+#else
+    m_ScriptSources.insert(QUrl::fromLocalFile(FileName).toString(), scriptId); // as QJSEngine::evaluate passes it to the compiler
+#endif
+    m_Scripts.insert(scriptId, SScript{ FileName, lineNumber, program, Name, dynamic });
+    qint64 publishedId = m_Registry.append(FileName, lineNumber, program);
+    Q_ASSERT(publishedId == scriptId);
+    Q_UNUSED(publishedId);
+    if (pScriptId) *pScriptId = scriptId;
+
+    if (dynamic) {
+        m_DynamicSources.insert(program, scriptId);
+        m_DynamicLruPos.insert(scriptId, m_DynamicLru.insert(m_DynamicLru.end(), scriptId));
+        m_DynamicBytes += program.size() * sizeof(QChar);
+        retainScripts();
+    }
     return FileName;
 }
 
+void CV4EngineExt::setScriptRetention(int maxDynamicScripts, qint64 maxDynamicBytes)
+{
+    m_MaxDynamicScripts = maxDynamicScripts;
+    m_MaxDynamicBytes = maxDynamicBytes;
+    retainScripts();
+}
+
+void CV4EngineExt::retainScripts()
+{
+    releaseScripts();
+
+    // never drop the most recent script, it is about to be evaluated
+    while (m_DynamicLru.size() > 1 
+        && ((m_MaxDynamicScripts > 0 && m_DynamicLru.size() > (size_t)m_MaxDynamicScripts) 
+         || (m_MaxDynamicBytes > 0 && m_DynamicBytes > m_MaxDynamicBytes)))
+        dropScript(m_DynamicLru.front());
+}
+
+void CV4EngineExt::releaseScripts()
+{
+    //
+    // Note: each function object holds a reference on its compilation unit, once only ours is left
+    //  the garbage collector has freed all functions of the script and it can be dropped again
+    //
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    const int unitRefs = 2; // ours and the engine's compilation unit cache
+#else
+    const int unitRefs = 1;
+#endif
+
+    QList<qint64> released;
+    for (auto I = m_LiveScripts.begin(); I != m_LiveScripts.end();) {
+        SScript& s = m_Scripts[*I];
+        if (s.Unit->count() > unitRefs) {
+            ++I;
+            continue;
+        }
+        s.Unit->release();
+        s.Unit = nullptr;
+        s.Live = false;
+        released.append(*I);
+        I = m_LiveScripts.erase(I);
+    }
+
+    // the script goes back into the lru list, unless the debugger pinned it as well
+    for (qint64 scriptId : released)
+        applyPin(scriptId, false);
+}
+
+void CV4EngineExt::dropScript(qint64 scriptId)
+{
+    auto S = m_Scripts.find(scriptId);
+    if (S == m_Scripts.end())
+        return;
+    SScript& s = *S;
+
+    auto L = m_DynamicLruPos.find(scriptId);
+    if (L != m_DynamicLruPos.end()) {
+        m_DynamicLru.erase(*L);
+        m_DynamicLruPos.erase(L);
+    }
+
+    auto I = m_DynamicSources.find(s.Source);
+    if (I != m_DynamicSources.end() && *I == scriptId)
+        m_DynamicSources.erase(I);
+    m_ScriptIDs.remove(s.Name.toLower());
+    m_ScriptNames.remove(s.Name);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    m_ScriptSources.remove(s.Name);
+#else
+    m_ScriptSources.remove(QUrl::fromLocalFile(s.Name).toString());
+#endif
+
+    // the id is never reused, lookups of it just fail from now on
+    m_DynamicBytes -= s.Source.size() * sizeof(QChar);
+    Q_ASSERT(!s.Unit);
+    m_Scripts.erase(S);
+    m_Registry.drop(scriptId);
+}
+
+void CV4EngineExt::pinScript(qint64 scriptId, bool pin)
+{
+    // the registry is owned by the engine's thread
+    QMetaObject::invokeMethod(this, [this, scriptId, pin]() { applyPin(scriptId, pin); }, Qt::QueuedConnection);
+}
+
+void CV4EngineExt::applyPin(qint64 scriptId, bool pin)
+{
+    auto S = m_Scripts.find(scriptId);
+    if (S == m_Scripts.end())
+        return;
+    SScript& s = *S;
+    s.Pins += pin ? 1 : -1;
+    if (!s.Dynamic)
+        return;
+
+    // pinned scripts are taken out of the lru list, but their size still counts
+    if (s.Pins > 0) {
+        auto L = m_DynamicLruPos.find(scriptId);
+        if (L != m_DynamicLruPos.end()) {
+            m_DynamicLru.erase(*L);
+            m_DynamicLruPos.erase(L);
+        }
+    } 
+    else if (!m_DynamicLruPos.contains(scriptId)) {
+        m_DynamicLruPos.insert(scriptId, m_DynamicLru.insert(m_DynamicLru.end(), scriptId));
+        retainScripts();
+    }
+}
+
+void CV4EngineExt::scriptEntered(qint64 scriptId, const QV4::Function* function)
+{
+    auto S = m_Scripts.find(scriptId);
+    if (S == m_Scripts.end())
+        return;
+    SScript& s = *S;
+    if (!s.Dynamic || s.Live || m_Evaluating.contains(scriptId) || !function)
+        return;
+
+    // a function created by the script outlived its evaluation, keep the source until all its functions are gone
+    s.Live = true;
+    s.Unit = function->executableCompilationUnit();
+    s.Unit->addref();
+    m_LiveScripts.append(scriptId);
+    applyPin(scriptId, true);
+}
+
+bool CV4EngineExt::isEngineThread() const
+{
+    return QThread::currentThread() == thread();
+}
+
+void CV4EngineExt::syncReaderIndex() const
+{
+    //
+    // Note: must be called with m_Reader.Mutex held, picks up what was appended and dropped since the last call
+    //
+
+    for (int count = m_Registry.count(); m_Reader.Count < count; m_Reader.Count++) {
+        qint64 scriptId = m_Reader.Count;
+        SV4ScriptEntry entry;
+        if (!m_Registry.get(scriptId, entry))
+            entry.Name.clear(); // already dropped
+        m_Reader.Names.append(entry.Name);
+        if (entry.Name.isEmpty())
+            continue;
+        m_Reader.IDs.insert(entry.Name.toLower(), scriptId);
+        m_Reader.ExactNames.insert(entry.Name, scriptId);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        m_Reader.Sources.insert(entry.Name, scriptId);
+#else
+        m_Reader.Sources.insert(QUrl::fromLocalFile(entry.Name).toString(), scriptId);
+#endif
+        m_Reader.NameSet.insert(entry.Name);
+    }
+
+    for (int drops = m_Registry.dropCount(); m_Reader.Drops < drops; m_Reader.Drops++) {
+        qint64 scriptId = m_Registry.droppedAt(m_Reader.Drops);
+        if (scriptId >= m_Reader.Names.size())
+            continue; // dropped before we indexed it
+        QString name = m_Reader.Names[scriptId];
+        if (name.isEmpty())
+            continue;
+        m_Reader.Names[scriptId].clear();
+        m_Reader.IDs.remove(name.toLower());
+        m_Reader.ExactNames.remove(name);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+        m_Reader.Sources.remove(name);
+#else
+        m_Reader.Sources.remove(QUrl::fromLocalFile(name).toString());
+#endif
+        m_Reader.NameSet.remove(name);
+    }
+}
+
+QSet<QString> CV4EngineExt::getScriptNames() const
+{
+    QMutexLocker locker(&m_Reader.Mutex);
+    syncReaderIndex();
+    return m_Reader.NameSet; // shared, not copied
+}
+
+QString CV4EngineExt::getScriptName(qint64 scriptId) const
+{
+    SV4ScriptEntry entry;
+    m_Registry.get(scriptId, entry);
+    return entry.Name;
+}
+
+QString CV4EngineExt::getScriptSource(qint64 scriptId) const
+{
+    SV4ScriptEntry entry;
+    m_Registry.get(scriptId, entry);
+    return entry.Source;
+}
+
+int CV4EngineExt::getScriptLineNumber(qint64 scriptId) const
+{
+    SV4ScriptEntry entry;
+    if (!m_Registry.get(scriptId, entry))
+        return -1;
+    return entry.LineNumber;
+}
+
+qint64 CV4EngineExt::getScriptId(const QString& fileName) const
+{
+    if (!isEngineThread()) {
+        QMutexLocker locker(&m_Reader.Mutex);
+        syncReaderIndex();
+        auto I = m_Reader.ExactNames.constFind(fileName);
+        if (I != m_Reader.ExactNames.constEnd())
+            return *I;
+        return m_Reader.IDs.value(fileName.toLower(), -1);
+    }
+
+    auto I = m_ScriptNames.constFind(fileName);
+    if (I != m_ScriptNames.constEnd())
+        return *I;
+    return m_ScriptIDs.value(fileName.toLower(), -1); // -1 if not found
+}
+
+qint64 CV4EngineExt::getScriptIdBySource(const QString& sourceFile) const
+{
+    if (!isEngineThread()) {
+        {
+            QMutexLocker locker(&m_Reader.Mutex);
+            syncReaderIndex();
+            auto I = m_Reader.Sources.constFind(sourceFile);
+            if (I != m_Reader.Sources.constEnd())
+                return *I;
+        }
+        return getScriptId(QUrl(sourceFile).fileName());
+    }
+
+    auto I = m_ScriptSources.constFind(sourceFile);
+    if (I != m_ScriptSources.constEnd())
+        return *I;
+
+    // not compiled through trackScript, resolve it once by name
+    qint64 scriptId = getScriptId(QUrl(sourceFile).fileName());
+    if (scriptId != -1)
+        m_ScriptSources.insert(sourceFile, scriptId);
+    return scriptId;
+}
+
 QV4::ReturnedValue printCall(const QV4::FunctionObject* b, const QV4::Value* v, const QV4::Value* argv, int argc)
 {
     QV4::Scope scope(b);
@@ -27,9 +27,14 @@
 
 #include <QObject>
 #include <QVariant>
+#include <QMutex>
+
+#include <list>
 
 #include "../V4ScriptDebugger/V4ScriptDebuggerApi.h"
+#include "V4ScriptRegistry.h"
 
+namespace QV4 { class ExecutableCompilationUnit; }
 
 class V4SCRIPTDEBUGGER_EXPORT CV4EngineExt : public QJSEngine, public CV4EngineItf
 {
@@ -42,20 +47,26 @@ public:
 
     Q_INVOKABLE QJSValue evaluateScript(const QString& program, const QString& fileName, int lineNumber = 1);
 
-    QSet<QString> getScriptNames() const
-    {
-        QSet<QString> names;
-        for (const SScript& s : m_Scripts)
-            names.insert(s.Name);
-        return names;
-    }
-    int getScriptCount() const { return m_Scripts.count(); }
-    QString getScriptName(qint64 scriptId) const { if (scriptId < m_Scripts.size()) return m_Scripts[scriptId].Name; return QString(); }
-    QString getScriptSource(qint64 scriptId) const { if (scriptId < m_Scripts.size()) return m_Scripts[scriptId].Source; return QString(); }
-    int getScriptLineNumber(qint64 scriptId) const { if (scriptId < m_Scripts.size()) return m_Scripts[scriptId].LineNumber; return -1; }
-    qint64 getScriptId(const QString& fileName) const { return m_ScriptIDs.value(fileName.toLower(), -1); } // -1 if not found
-
-    QString trackScript(const QString& program, const QString& fileName, int lineNumber = 1);
+    //
+    // Note: the script getters may be called from any thread, the registry is lock-free for readers
+    //
+    QSet<QString> getScriptNames() const;
+    int getScriptCount() const { return m_Registry.count(); }
+    QString getScriptName(qint64 scriptId) const;
+    QString getScriptSource(qint64 scriptId) const;
+    int getScriptLineNumber(qint64 scriptId) const;
+    qint64 getScriptId(const QString& fileName) const;
+    qint64 getScriptIdBySource(const QString& sourceFile) const;
+
+    QString trackScript(const QString& program, const QString& fileName, int lineNumber = 1, qint64* pScriptId = nullptr);
+
+    // limits the sources kept for eval code and unnamed scripts, 0 means unlimited which is the default, call from the engine's thread,
+    // scripts whose functions outlived their evaluation are only pinned while a debug agent reports the calls into them
+    void setScriptRetention(int maxDynamicScripts, qint64 maxDynamicBytes);
+
+    void pinScript(qint64 scriptId, bool pin = true);
+    void scriptEntered(qint64 scriptId, const QV4::Function* function);
+    int scriptDropCount() const { return m_Registry.dropCount(); }
 
     static CV4EngineExt* getEngineByHandle(void* handle);
 
@@ -65,14 +76,59 @@ signals:
     void invokeDebugger();
 
 protected:
+    // engine thread only bookkeeping, readers use m_Registry
     struct SScript
     {
         QString Name;
         int LineNumber = 0;
         QString Source;
+        QString BaseName;
+        bool Dynamic = false;
+        bool Live = false;  // functions of the script were entered after its evaluation finished
+        int Pins = 0;
+        QV4::ExecutableCompilationUnit* Unit = nullptr; // referenced while live, to tell when the script's last function is gone
+    };
+
+    static bool isDynamicScript(const QString& name) { return name.isEmpty() || name == "eval code"; }
+    void applyPin(qint64 scriptId, bool pin);
+    void retainScripts();
+    void releaseScripts();
+    void dropScript(qint64 scriptId);
+
+    bool isEngineThread() const;
+    void syncReaderIndex() const;
+
+    CV4ScriptRegistry m_Registry;
+
+    QHash<qint64, SScript> m_Scripts; // dropped scripts are removed, ids are never reused
+    QMap<QString, qint64> m_ScriptIDs; // lower case name -> id
+    QHash<QString, qint64> m_ScriptNames; // exact name -> id
+    mutable QHash<QString, qint64> m_ScriptSources; // source file url as seen by the engine -> id
+    QHash<QString, int> m_NameSuffixes; // lower case name -> last used " (N)" suffix
+
+    // dynamic scripts are deduplicated by content and dropped least recently used first, unless pinned
+    QHash<QString, qint64> m_DynamicSources; // source -> id
+    std::list<qint64> m_DynamicLru;
+    QHash<qint64, std::list<qint64>::iterator> m_DynamicLruPos;
+    qint64 m_DynamicBytes = 0;
+    int m_MaxDynamicScripts;
+    qint64 m_MaxDynamicBytes;
+    QVector<qint64> m_Evaluating;
+    QList<qint64> m_LiveScripts;
+
+    // lookup tables of other threads, built incrementally from the registry and its drop log
+    struct SReaderIndex
+    {
+        QMutex Mutex; // only contended between readers, the engine's thread does not need it to track scripts
+        int Count = 0;
+        int Drops = 0;
+        QVector<QString> Names; // id -> name
+        QMap<QString, qint64> IDs; // lower case name -> id
+        QHash<QString, qint64> ExactNames;
+        QHash<QString, qint64> Sources;
+        QSet<QString> NameSet;
     };
-    QList<SScript> m_Scripts;
-    QMap<QString, qint64> m_ScriptIDs;
+    mutable SReaderIndex m_Reader;
 
 private:
     QJSValue evaluate(const QString& program, const QString& fileName = QString(), int lineNumber = 1) { return QJSValue(); } // dont use this, use evaluateScript instead
@@ -32,9 +32,12 @@
 #include <QMainWindow>
 #endif /* CDP_FRONTEND */
 #include <QLibrary>
+#include <QUrl>
 
 #include "v4scriptdebugger_global.h"
 
+namespace QV4 { struct Function; }
+
 class CV4EngineItf
 {
 public:
@@ -47,6 +50,16 @@ public:
     virtual int getScriptLineNumber(qint64 scriptId) const = 0;
     virtual qint64 getScriptId(const QString& fileName) const = 0;
 
+    // sourceFile as reported by the engine, e.g. QV4::Function::sourceFile(), implementations should intern it when the script is compiled
+    virtual qint64 getScriptIdBySource(const QString& sourceFile) const { return getScriptId(QUrl(sourceFile).fileName()); }
+
+    // scripts may drop the source of dynamic code, pinned scripts must be kept, called from the debugger's thread
+    virtual void pinScript(qint64 scriptId, bool pin = true) {}
+    // called by the debug agent in the engine's thread when a function of the script is entered
+    virtual void scriptEntered(qint64 scriptId, const QV4::Function* function) {}
+    // grows whenever a script is dropped, lookups cached by the agent are stale once it changed
+    virtual int scriptDropCount() const { return 0; }
+
     //
     // Note: the implementation of this interface must be derived from 
     //  QObject and include the following signals and slots:
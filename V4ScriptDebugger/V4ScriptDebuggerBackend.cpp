@@ -29,6 +29,8 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
+#include <QRegularExpression>
+#include <QScopeGuard>
 
 #include <private/qv4engine_p.h>
 #include <private/qv4debugging_p.h>
@@ -48,22 +50,124 @@
 #include "debug_out.h"
 #include "dump_variant.h"
 
+// object group of refs which are only valid during the current pause, as in V8
+#define PAUSE_OBJECT_GROUP "backtrace"
+#define BACKTRACE_FRAME_LIMIT 64
+#define ENGINE_JOB_TIMEOUT 5000
+#define EVALUATE_TIMEOUT 10000
+#define EVALUATE_ABORT_TIMEOUT 1000
+#define PROPERTY_BUCKET_SIZE 100
+#define PROPERTY_BUCKET_LIMIT 0x10000
+
+// the attributes a read only command of a paused engine depends on
+struct SV4PauseKey
+{
+	int type;
+	int contextIndex;
+	quint64 objectId;
+	int filter;
+	int offset;
+	int count;
+	bool cdpValues;
+
+	bool operator==(const SV4PauseKey& other) const {
+		return type == other.type && contextIndex == other.contextIndex && objectId == other.objectId
+			&& filter == other.filter && offset == other.offset && count == other.count && cdpValues == other.cdpValues;
+	}
+};
+
+inline size_t qHash(const SV4PauseKey& key, size_t seed = 0)
+{
+	return qHashMulti(seed, key.type, key.contextIndex, key.objectId, key.filter, key.offset, key.count, key.cdpValues);
+}
+
+// FIFO of pending events, the ring grows by doubling so no event is ever dropped
+class CV4EventQueue
+{
+public:
+	CV4EventQueue() : m_ring(64), m_head(0), m_size(0) {}
+
+	int size() const { return m_size; }
+	bool isEmpty() const { return m_size == 0; }
+
+	void append(SV4Event event)
+	{
+		if (m_size == m_ring.size()) {
+			QVector<SV4Event> ring(m_ring.size() * 2);
+			for (int i = 0; i < m_size; i++)
+				ring[i] = std::move(m_ring[(m_head + i) & (m_ring.size() - 1)]);
+			m_ring.swap(ring);
+			m_head = 0;
+		}
+		m_ring[(m_head + m_size++) & (m_ring.size() - 1)] = std::move(event);
+	}
+
+	SV4Event takeFirst()
+	{
+		SV4Event event = std::move(m_ring[m_head]);
+		m_ring[m_head] = SV4Event();
+		m_head = (m_head + 1) & (m_ring.size() - 1);
+		m_size--;
+		return event;
+	}
+
+	QList<SV4Event> take(int max = 0) // 0 takes all
+	{
+		int count = (max > 0 && max < m_size) ? max : m_size;
+		QList<SV4Event> events;
+		events.reserve(count);
+		while (count-- > 0)
+			events.append(takeFirst());
+		return events;
+	}
+
+private:
+	QVector<SV4Event> m_ring; // size is a power of two
+	int m_head;
+	int m_size;
+};
+
 class CV4ScriptDebuggerBackendPrivate : public QObjectPrivate
 {
 	Q_DECLARE_PUBLIC(CV4ScriptDebuggerBackend)
 public:
 
-	CV4EngineItf*			engine;
+	CV4EngineItf*			engine = nullptr;
 	QPointer<CV4DebugAgent>	debugger;
-	CV4DebugHandler*		handler;
+	QPointer<CV4DebugAgent>	installedAgent; // the engine can not uninstall it, so later sessions reuse it
+	CV4DebugHandler*		handler = nullptr;
+	bool					weakRefs = false;
+	CV4DebugHandler::EPropertyCount propertyCount = CV4DebugHandler::eFastCount;
+	int						pausedFrameLimit = 0;
+	int						pauseId = 0; // counts the pauses, see SV4Event::pauseId
+	int						jobTimeout = ENGINE_JOB_TIMEOUT;
+	int						evaluateTimeout = EVALUATE_TIMEOUT;
+
+	CV4EventQueue			pendingEvents;
 
-	QVariantList			pendingEvents;
+	QList<QPair<int, SV4Command>> queuedCommands;
+	QHash<quint64, QSharedPointer<CV4GetPropsJob>> prefetchedObjects; // valid while a batch of commands is handled, nullptr if the engine was busy
+
+	// what was inspected during the current pause, dropped as a whole on resume or once a command may change something
+	QHash<quint64, SV4Object> pauseObjects; // handle -> object
+	QHash<SV4PauseKey, SV4Result> pauseResults;
+
+	QMap<int, SV4Breakpoint> detachedBreakpoints; // kept while the agent is not installed
+
+	struct SPropertyBucket
+	{
+		quint64 object;
+		qint64 from;
+		qint64 to;
+	};
+	QVector<SPropertyBucket> propertyBuckets; // index -> bucket, valid till the engine resumes
+	uint					bucketGeneration = 0;
 
 	QSet<qint64>			checkpointScripts;
 	QSet<qint64>			previousCheckpointScripts;
 
 	int						nextScriptObjectSnapshotId;
-	QMap<int, struct SV4Object*> scriptObjectSnapshots;
+	QMap<int, struct SV4ObjectSnapshot*> scriptObjectSnapshots;
 
 	int						nextScriptValueIteratorId;
 	QMap<int, struct SV4ValueIterator*> scriptValueIterators;
@@ -73,6 +177,9 @@ public:
 CV4ScriptDebuggerBackend::CV4ScriptDebuggerBackend(QObject *parent)
 	: QObject(*new CV4ScriptDebuggerBackendPrivate, parent)
 {
+	qRegisterMetaType<SV4Command>();
+	qRegisterMetaType<SV4Result>();
+	qRegisterMetaType<QList<SV4Event>>();
 }
 
 CV4ScriptDebuggerBackend::~CV4ScriptDebuggerBackend()
@@ -87,7 +194,7 @@ void CV4ScriptDebuggerBackend::clear()
 	d->checkpointScripts.clear();
 	d->previousCheckpointScripts.clear();
 
-	foreach(SV4Object * snap, d->scriptObjectSnapshots)
+	foreach(SV4ObjectSnapshot * snap, d->scriptObjectSnapshots)
 		delete snap;
 
 	foreach(SV4ValueIterator * iter, d->scriptValueIterators)
@@ -105,13 +212,30 @@ QVariant CV4ScriptDebuggerBackend::handleRequest(const QVariant& var)
 		{
 			QVariantMap out;
 			if (!d->pendingEvents.isEmpty())
-				out["Event"] = d->pendingEvents.takeFirst();
+				out["Event"] = d->pendingEvents.takeFirst().toVariant();
+			return out;
+		}
+		else if (in["Control"] == "PullEvents") // drains all or up to "Max" events in one go
+		{
+			QVariantList events;
+			foreach(const SV4Event& event, d->pendingEvents.take(in["Max"].toInt()))
+				events.append(event.toVariant());
+			QVariantMap out;
+			out["Events"] = events;
 			return out;
 		}
 		else if (in["Control"] == "Detach")
 		{
 			detach();
 		}
+		else if (in["Control"] == "AttachAgent")
+		{
+			attachAgent();
+		}
+		else if (in["Control"] == "DetachAgent")
+		{
+			detachAgent();
+		}
 	}
 	else if (in.contains("Command"))
 	{
@@ -136,6 +260,40 @@ void CV4ScriptDebuggerBackend::processRequest(const QVariant& var)
 	emit sendResponse(handleRequest(var));
 }
 
+void CV4ScriptDebuggerBackend::processCommand(int id, const SV4Command& command)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	// commands which arrive together, like a variables view refreshing, are handled as one batch
+	if (d->queuedCommands.isEmpty())
+		QMetaObject::invokeMethod(this, "processQueuedCommands", Qt::QueuedConnection);
+	d->queuedCommands.append(qMakePair(id, command));
+}
+
+void CV4ScriptDebuggerBackend::processQueuedCommands()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	QList<QPair<int, SV4Command>> Commands;
+	Commands.swap(d->queuedCommands);
+
+	QList<SV4Result> Results = onCommands(Commands);
+	for (int i = 0; i < Commands.size(); i++)
+		emit sendResult(Commands[i].first, Results[i]);
+}
+
+QList<SV4Event> CV4ScriptDebuggerBackend::takeEvents(int max)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	return d->pendingEvents.take(max);
+}
+
+void CV4ScriptDebuggerBackend::pullEvents(int max)
+{
+	emit sendEvents(takeEvents(max));
+}
+
 static void deleteFromMapByValue(QMap<QString, int>& map, int targetValue)
 {
 	auto it = std::find_if(map.begin(), map.end(), [&](const int& v){ return v == targetValue; });
@@ -144,23 +302,269 @@ static void deleteFromMapByValue(QMap<QString, int>& map, int targetValue)
 }
 
 QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Command)
+{
+	return onCommand(id, SV4Command::fromVariant(Command)).toVariant();
+}
+
+static quint64 inspectedObject(const SV4Command& Command)
+{
+	switch (Command.type)
+	{
+	case SV4Command::eScriptObjectSnapshotCapture:
+	case SV4Command::eNewScriptValueIterator:
+		return Command.objectId;
+	case SV4Command::eGetThisObject: {
+		UV4Handle Handle = { 0 };
+		Handle.type = UV4Handle::eThis;
+		Handle.frame = Command.contextIndex;
+		return Handle.value;
+	}
+	case SV4Command::eGetPropertyRange: {
+		// objects are read in ranges, only scopes and this objects are captured as a whole
+		UV4Handle Handle = { Command.objectId };
+		return Handle.type == UV4Handle::eScope || Handle.type == UV4Handle::eThis ? Command.objectId : 0;
+	}
+	default:
+		return 0;
+	}
+}
+
+static bool isInspection(SV4Command::EType type)
+{
+	// commands which do not change the engine's state
+	switch (type)
+	{
+	case SV4Command::eScriptObjectSnapshotCapture:
+	case SV4Command::eNewScriptValueIterator:
+	case SV4Command::eGetThisObject:
+	case SV4Command::eNewScriptObjectSnapshot:
+	case SV4Command::eDeleteScriptObjectSnapshot:
+	case SV4Command::eGetPropertiesByIterator:
+	case SV4Command::eDeleteScriptValueIterator:
+	case SV4Command::eGetScopeChain:
+	case SV4Command::eGetActivationObject:
+	case SV4Command::eGetContextCount:
+	case SV4Command::eGetContextInfo:
+	case SV4Command::eGetBacktrace:
+	case SV4Command::eGetPropertyRange:
+	case SV4Command::eGetCallFrames:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool isPauseCacheable(SV4Command::EType type)
+{
+	// inspections whose result only depends on the paused state and the command's attributes
+	switch (type)
+	{
+	case SV4Command::eGetThisObject:
+	case SV4Command::eGetScopeChain:
+	case SV4Command::eGetActivationObject:
+	case SV4Command::eGetContextCount:
+	case SV4Command::eGetContextInfo:
+	case SV4Command::eGetBacktrace:
+	case SV4Command::eGetPropertyRange:
+	case SV4Command::eGetCallFrames:
+		return true;
+	default:
+		return false;
+	}
+}
+
+QList<SV4Result> CV4ScriptDebuggerBackend::onCommands(const QList<QPair<int, SV4Command>>& Commands)
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	QVariantMap Response;
+	//
+	// Note: the objects inspected by the leading read only commands are captured in one batch of jobs,
+	//	so the engine is woken up once instead of once per command
+	//
 
-	QString typeStr = Command["type"].toString();
-	QVariantMap Attributes = Command["attributes"].toMap();
+	QList<CV4DebugJobPtr> Jobs;
+	QList<CV4DebugJobPtr> PauseJobs; // their refs are released once the engine resumes, see onCommand
+	if (d->debugger && d->debugger->thread() == d->engine->self()->thread() && Commands.size() > 1) {
+		bool paused = d->debugger->isPaused();
+		for (int i = 0; i < Commands.size() && isInspection(Commands[i].second.type); i++) {
+			quint64 handle = inspectedObject(Commands[i].second);
+			if (!handle || d->prefetchedObjects.contains(handle) || d->pauseObjects.contains(handle))
+				continue;
+			UV4Handle Handle = { handle };
+			QSharedPointer<CV4GetPropsJob> job(new CV4GetPropsJob(d->handler, Handle));
+			d->prefetchedObjects.insert(handle, job);
+			if (paused && isPauseCacheable(Commands[i].second.type))
+				PauseJobs.append(job);
+			else
+				Jobs.append(job);
+		}
 
-#ifdef _DEBUG
-	QJsonDocument doc(QJsonValue::fromVariant(Attributes).toObject());
-	QByteArray Temp = doc.toJson();
-	//qDebug() << "cmd: " << typeStr;
-#endif
-	DEBUG_LOG << "XXX V4 command: " << dumpVariant(Command);
+		bool success = Jobs.isEmpty() || runInEngine(Jobs);
+		if (success && !PauseJobs.isEmpty()) {
+			d->handler->setRefGroup(PAUSE_OBJECT_GROUP);
+			success = runInEngine(PauseJobs);
+			d->handler->setRefGroup(QString());
+		}
+		if (!success) {
+			// don't wait again for each command
+			for (auto I = d->prefetchedObjects.begin(); I != d->prefetchedObjects.end(); ++I)
+				I.value().reset();
+		}
+	}
+
+	QList<SV4Result> Results;
+	for (int i = 0; i < Commands.size(); i++) {
+		if (!isInspection(Commands[i].second.type))
+			d->prefetchedObjects.clear(); // the objects may have changed
+		Results.append(onCommand(Commands[i].first, Commands[i].second));
+	}
+
+	d->prefetchedObjects.clear();
+	return Results;
+}
+
+SV4Object CV4ScriptDebuggerBackend::inspectObject(quint64 handle, bool* ok)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	auto I = d->pauseObjects.constFind(handle);
+	if (I != d->pauseObjects.constEnd()) {
+		if (ok)
+			*ok = true;
+		return *I;
+	}
+
+	bool success;
+	SV4Object object;
+	if (d->prefetchedObjects.contains(handle)) {
+		QSharedPointer<CV4GetPropsJob> prefetched = d->prefetchedObjects.value(handle);
+		success = !prefetched.isNull();
+		if (success)
+			object = prefetched->returnValue();
+	}
+	else {
+		UV4Handle Handle = { handle };
+		QSharedPointer<CV4GetPropsJob> job(new CV4GetPropsJob(d->handler, Handle));
+		success = runInEngine(job);
+		object = job->returnValue();
+	}
+
+	// a running engine may change the object any time
+	if (success && d->debugger->isPaused())
+		d->pauseObjects.insert(handle, object);
+	if (ok)
+		*ok = success;
+	return object;
+}
+
+void CV4ScriptDebuggerBackend::clearPauseCache()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->pauseObjects.clear();
+	d->pauseResults.clear();
+}
+
+QVariantList CV4ScriptDebuggerBackend::makePropertyBuckets(quint64 object, qint64 from, qint64 to, bool cdp)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	// the buckets span a power of the bucket size, so a range never splits into more than the bucket size
+	qint64 size = PROPERTY_BUCKET_SIZE;
+	while ((to - from + size - 1) / size > PROPERTY_BUCKET_SIZE)
+		size *= PROPERTY_BUCKET_SIZE;
+
+	if (d->propertyBuckets.size() >= PROPERTY_BUCKET_LIMIT)
+		clearPropertyBuckets(); // a client still holding an old bucket gets InvalidObjectId
+
+	QVariantList Buckets;
+	for (qint64 i = from; i < to; i += size) {
+		qint64 end = qMin(i + size, to);
+
+		UV4Handle Handle = { 0 };
+		Handle.type = UV4Handle::eBucket;
+		Handle.generation = d->bucketGeneration;
+		Handle.ref = d->propertyBuckets.size();
+		d->propertyBuckets.append({ object, i, end });
+
+		QVariantMap Bucket;
+		Bucket["name"] = QString("[%1 %2 %3]").arg(i).arg(QChar(0x2026)).arg(end - 1);
+		if (cdp) {
+			Bucket["value"] = QVariantMap{ {"type", "object"}, {"subtype", "array"}, {"className", "Array"},
+				{"description", QString("Array(%1)").arg(end - i)}, {"objectId", QString::number(Handle.value)} };
+			Bucket["writable"] = false;
+			Bucket["configurable"] = false;
+			Bucket["enumerable"] = true;
+			Bucket["isOwn"] = true;
+		}
+		else {
+			Bucket["value"] = QVariantMap{ {"type", "ObjectValue"}, {"value", Handle.value} };
+			Bucket["valueAsString"] = QString::number(end - i);
+			Bucket["flags"] = 0;
+		}
+		Buckets.append(Bucket);
+	}
+	return Buckets;
+}
+
+void CV4ScriptDebuggerBackend::clearPropertyBuckets()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->propertyBuckets.clear();
+	d->bucketGeneration = (d->bucketGeneration + 1) & 0xFFFFFF; // the handle keeps 24 bits
+}
+
+//
+// Note: evaluations have a time budget, once it is used up the engine is interrupted,
+//	returns an empty string or the error of the command
+//
+QString CV4ScriptDebuggerBackend::runEvaluation(const CV4DebugJobPtr& job, int timeout)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	CV4JobBatchPtr batch = d->debugger->queueJobs(QList<CV4DebugJobPtr>() << job);
+	if (batch->waitForFinished(timeout > 0 ? timeout : -1))
+		return QString();
+	if (batch->cancel()) // a running engine did not reach a safepoint in time
+		return "EngineBusy";
+	bool interrupted = batch->interrupt();
+	if (!batch->waitForFinished(EVALUATE_ABORT_TIMEOUT)) // stuck in a native call, the batch frees the job once it returns
+		return "EvaluateTimeout";
+	return interrupted ? "EvaluateTimeout" : QString();
+}
+
+//
+// Note: this is a syntactic best effort heuristic, not side effect tracking by the engine,
+//	any call, assignment, update, construction or template literal counts as a side effect,
+//	but a getter, a proxy trap or a valueOf/toString coercion reached through a plain
+//	member access or an operator still runs unnoticed
+//
+
+static bool mayHaveSideEffects(const QString& program)
+{
+	static const QRegularExpression sideEffectRe(R"(\(|`|\+\+|--|<<=|>>=|(?<![=!<>])=(?!=)|\b(new|delete|function|class|yield|await|import)\b)");
+	return sideEffectRe.match(program).hasMatch();
+}
+
+bool CV4ScriptDebuggerBackend::runInEngine(const QList<CV4DebugJobPtr>& jobs)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	// a paused engine runs the jobs right away, a running one at its next safepoint which a long native call may delay
+	return d->debugger->runJobsInEngine(jobs, d->debugger->isPaused() ? -1 : d->jobTimeout);
+}
+
+SV4Result CV4ScriptDebuggerBackend::onCommand(int id, const SV4Command& Command)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	SV4Result Response;
+
+	DEBUG_LOG << "XXX V4 command: " << SV4Command::typeName(Command.type);
 
 	if (!d->debugger) {
-		Response["error"] = "DetachedError";
+		Response.error = "DetachedError";
 		return Response;
 	}
 
@@ -173,68 +577,112 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		DEBUG_LOG << "V4DebugAgent moved to engine's thread";
 	}
 
+	//
+	// Note: clients ask for the same scopes, this objects and properties many times during a pause,
+	//	the results are kept till the engine resumes or a command which may change its state comes in
+	//
+	if (!isInspection(Command.type))
+		clearPauseCache();
+	if (Command.type == SV4Command::eGetCallFrames && Command.pauseId != 0 && Command.pauseId != d->pauseId) {
+		Response.error = "NotPaused"; // the engine resumed since, even if it paused again
+		return Response;
+	}
+	bool cacheable = isPauseCacheable(Command.type) && d->debugger->isPaused();
+	SV4PauseKey Key = { Command.type, Command.contextIndex, Command.objectId, Command.filter, Command.offset, Command.count, Command.cdpValues };
+	if (cacheable) {
+		auto I = d->pauseResults.constFind(Key);
+		if (I != d->pauseResults.constEnd())
+			return *I;
+	}
+
+	// the refs handed out while inspecting a paused engine are released once it resumes,
+	// snapshots and iterators keep theirs as the QtScript debugger compares them across steps
+	bool pauseRefs = cacheable;
+	if (pauseRefs)
+		d->handler->setRefGroup(PAUSE_OBJECT_GROUP);
+	auto restoreRefGroup = qScopeGuard([&]() {
+		if (pauseRefs)
+			d->handler->setRefGroup(QString());
+	});
+
 	
-	if (typeStr == "Interrupt")
+	if (Command.type == SV4Command::eInterrupt)
 	{
 		d->debugger->pause();
 	}
-	else if (typeStr == "Continue" || typeStr == "StepInto" || typeStr == "StepOver" || typeStr == "StepOut" || typeStr == "Resume")
+	else if (Command.type == SV4Command::eContinue || Command.type == SV4Command::eStepInto || Command.type == SV4Command::eStepOver || Command.type == SV4Command::eStepOut || Command.type == SV4Command::eResume)
 	{
 		CV4DebugAgent::Stepping stepping = CV4DebugAgent::NotStepping;
-		if (typeStr == "StepInto")
+		if (Command.type == SV4Command::eStepInto)
 			stepping = CV4DebugAgent::StepIn;
-		else if (typeStr == "StepOver")
+		else if (Command.type == SV4Command::eStepOver)
 			stepping = CV4DebugAgent::StepOver;
-		else if (typeStr == "StepOut")
+		else if (Command.type == SV4Command::eStepOut)
 			stepping = CV4DebugAgent::StepOut;
+		if (d->debugger->isPaused()) {
+			d->debugger->runJobInEngine(CV4DebugJobPtr(new CV4ReleaseJob(d->handler, CV4ReleaseJob::eGroup, { 0 }, PAUSE_OBJECT_GROUP)));
+		}
+		clearPropertyBuckets();
 		d->debugger->resume(stepping);
-		Response["async"] = true;
+		Response.async = true;
 	}
 	
-	else if (typeStr == "RunToLocation" || typeStr == "RunToLocationByID")
+	else if (Command.type == SV4Command::eRunToLocation || Command.type == SV4Command::eRunToLocationByID)
 	{
-		int lineNumber = Attributes["lineNumber"].toInt();
 		QString fileName;
-		if (typeStr == "RunToLocationByID") {
-			quint64 scriptId = Attributes["scriptId"].toULongLong();
-			fileName = d->engine->getScriptName(scriptId);
-		} else
-			fileName = Attributes["fileName"].toString();
-		d->debugger->runUntil(fileName, lineNumber);
-		Response["async"] = true;
+		if (Command.type == SV4Command::eRunToLocationByID)
+			fileName = d->engine->getScriptName(Command.scriptId);
+		else
+			fileName = Command.fileName;
+		d->debugger->runUntil(fileName, Command.lineNumber);
+		Response.async = true;
 	}
 	
-	else if (typeStr == "Evaluate")
+	else if (Command.type == SV4Command::eEvaluate)
 	{
-		int contextIndex = Attributes["contextIndex"].toInt();
-		QString fileName = Attributes["fileName"].toString();
-		int lineNumber = Attributes["lineNumber"].toInt();
-		QString program = Attributes["program"].toString();
-		
-		if (d->debugger->isPaused())
-		{
-			int frameNr = 0; // todo
+		const QString& program = Command.program;
+
+		if (Command.throwOnSideEffect && mayHaveSideEffects(program)) {
+			Response.error = "SideEffect";
+			return Response;
+		}
 
-			// Note: this mode is blocking - use only fast to evaluate expressions !!!
-			CV4RunScriptJob job(d->debugger->engine(), d->handler, program, frameNr/*, -1*/);
-			d->debugger->runJobInEngine(&job);
-			evalFinished(job.returnValue().toVariant(), job.exceptionMessage());
+		bool paused = d->debugger->isPaused();
+		if (paused || d->debugger->isRunningScript())
+		{
+			// Note: this mode is blocking, the evaluation is interrupted once its time budget is used up,
+			//	a busy engine evaluates at its next safepoint instead of once the script returned,
+			//	then in the global scope as the function it is in is not the one the client looks at
+			int frameNr = paused ? Command.contextIndex : -1;
+			int timeout = d->evaluateTimeout;
+			if (Command.timeout > 0 && (timeout <= 0 || Command.timeout < timeout))
+				timeout = Command.timeout;
+
+			QSharedPointer<CV4RunScriptJob> job(new CV4RunScriptJob(d->debugger->engine(), d->handler, program, frameNr/*, -1*/));
+			d->handler->setRefGroup(Command.objectGroup);
+			QString error = runEvaluation(job, timeout);
+			d->handler->setRefGroup(QString());
+			if (!error.isEmpty()) {
+				Response.error = error;
+				return Response;
+			}
+			evalFinished(job->returnValue().toVariant(), job->exceptionMessage());
 		}
 		else
 		{
 			// Note: this mode is not blocking
-			QMetaObject::invokeMethod(d->engine->self(), "evaluateScript", Qt::QueuedConnection, Q_ARG(QString, program), Q_ARG(QString, fileName), Q_ARG(int, lineNumber));
+			QMetaObject::invokeMethod(d->engine->self(), "evaluateScript", Qt::QueuedConnection, Q_ARG(QString, program), Q_ARG(QString, Command.fileName), Q_ARG(int, Command.lineNumber));
 		}
-		Response["async"] = true;
+		Response.async = true;
 	}
-	else if (typeStr == "ForceReturn") // Used only in console commands
+	else if (Command.type == SV4Command::eForceReturn) // Used only in console commands
 	{
 		// does not seam to be supported by the V4 engine
 	}
 
-	else if (typeStr == "SetBreakpoint")
+	else if (Command.type == SV4Command::eSetBreakpoint)
 	{
-		QVariantMap in = Attributes["breakpointData"].toMap();
+		const QVariantMap& in = Command.breakpointData;
 
 		SV4Breakpoint bp;
 		DEBUG_LOG << "XXX Setting breakpoint: " << dumpVariant(in);
@@ -248,27 +696,37 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 
 		if (scriptId > -1) {
 			bp.fileName = d->engine->getScriptName(scriptId);
+			d->engine->pinScript(scriptId); // keep the source of dynamic code with breakpoints
 			int breakPointId = d->debugger->setBreakpoint(bp);
 			QString breakpointIdentfier = bp.fileName + ":" + QString::number(bp.lineNumber);
 			d->filenameAndBreakpointToBreakpointId[breakpointIdentfier] = breakPointId;
-			Response["result"] = breakPointId;
+			Response.result = breakPointId;
 			DEBUG_LOG << "XXX Setting breakpoint for filename: " << bp.fileName << " with breakpointIdentfier: " << breakpointIdentfier << " breakpointId: " << breakPointId;
 		}
 		else {
 			DEBUG_LOG << "XXX Warning: Setting breakpoint in unknown script: " << scriptName;
-			Response["error"] = "UnknownScriptSpecified";
+			Response.error = "UnknownScriptSpecified";
 		}
 	}
-	else if (typeStr == "DeleteBreakpoint")
+	else if (Command.type == SV4Command::eDeleteBreakpoint)
 	{
-		deleteFromMapByValue(d->filenameAndBreakpointToBreakpointId, Attributes["breakpointId"].toInt());
-		d->debugger->deleteBreakpoint(Attributes["breakpointId"].toInt());
+		int breakpointId = Command.breakpointId;
+		QMap<int, SV4Breakpoint> breakpoints = d->debugger->getBreakpoints();
+		auto I = breakpoints.constFind(breakpointId);
+		if (I != breakpoints.constEnd())
+			d->engine->pinScript(d->engine->getScriptId(I->fileName), false);
+
+		deleteFromMapByValue(d->filenameAndBreakpointToBreakpointId, breakpointId);
+		d->debugger->deleteBreakpoint(breakpointId);
 	}
-	else if (typeStr == "DeleteAllBreakpoints")
+	else if (Command.type == SV4Command::eDeleteAllBreakpoints)
 	{
+		foreach(const SV4Breakpoint& bp, d->debugger->getBreakpoints())
+			d->engine->pinScript(d->engine->getScriptId(bp.fileName), false);
+
 		d->debugger->deleteAllBreakpoints();
 	}
-	else if (typeStr == "GetBreakpoints")
+	else if (Command.type == SV4Command::eGetBreakpoints)
 	{
 		QVariantList result;
 		QMap<int, SV4Breakpoint> breakpoints = d->debugger->getBreakpoints();
@@ -279,41 +737,47 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 			out["scriptId"] = d->engine->getScriptId(I.value().fileName);
 			result.append(out);
 		}
-		Response["result"] = result;
-		Response["type"] = "QScriptBreakpointMap";
+		Response.result = result;
+		Response.type = "QScriptBreakpointMap";
 	}
-	else if (typeStr == "GetBreakpointData")
+	else if (Command.type == SV4Command::eGetBreakpointData)
 	{
 		QMap<int, SV4Breakpoint> breakpoints = d->debugger->getBreakpoints();
-		auto I = breakpoints.find(Attributes["breakpointId"].toInt());
+		auto I = breakpoints.find(Command.breakpointId);
 		if (I != breakpoints.end())
 		{
 			QVariantMap out = I.value().toVariant();
 			out["id"] = I.key();
 			out["scriptId"] = d->engine->getScriptId(I.value().fileName);
-			Response["result"] = out;
-			Response["type"] = "QScriptBreakpointData";
+			Response.result = out;
+			Response.type = "QScriptBreakpointData";
 		}  else
-			Response["error"] = "InvalidBreakpointID";
+			Response.error = "InvalidBreakpointID";
 	}
-	else if (typeStr == "SetBreakpointData")
+	else if (Command.type == SV4Command::eSetBreakpointData)
 	{
-		QVariantMap in = Attributes["breakpointData"].toMap();
+		const QVariantMap& in = Command.breakpointData;
 
 		SV4Breakpoint bp;
 		bp.fromVariant(in);
 		if (quint64 scriptId = in["scriptId"].toLongLong())
 			bp.fileName = d->engine->getScriptName(scriptId);
 
-		if(!d->debugger->updateBreakpoint(Attributes["breakpointId"].toInt(), bp))
-			Response["error"] = "InvalidBreakpointID";
+		int breakpointId = Command.breakpointId;
+		QString oldFileName = d->debugger->getBreakpoints().value(breakpointId).fileName;
+		if(!d->debugger->updateBreakpoint(breakpointId, bp))
+			Response.error = "InvalidBreakpointID";
+		else if (oldFileName != bp.fileName) {
+			d->engine->pinScript(d->engine->getScriptId(oldFileName), false);
+			d->engine->pinScript(d->engine->getScriptId(bp.fileName));
+		}
 	}
 
-	else if (typeStr == "GetScriptData")
+	else if (Command.type == SV4Command::eGetScriptData)
 	{
-		quint64 scriptId = Attributes["scriptId"].toULongLong();
+		quint64 scriptId = Command.scriptId;
 		if (scriptId >= d->engine->getScriptCount()) {
-			Response["error"] = "InvalidScriptID";
+			Response.error = "InvalidScriptID";
 			return Response;
 		}
 
@@ -323,14 +787,14 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		Result["baseLineNumber"] = d->engine->getScriptLineNumber(scriptId);
 		//Result["timeStamp"] = .toLongLong();
 
-		Response["result"] = Result;
-		Response["type"] = "QScriptScriptData";
+		Response.result = Result;
+		Response.type = "QScriptScriptData";
 	}
-	else if (typeStr == "ResolveScript") // used only in console commands
+	else if (Command.type == SV4Command::eResolveScript) // used only in console commands
 	{
-		Response["result"] = d->engine->getScriptId(Attributes["fileName"].toString());
+		Response.result = d->engine->getScriptId(Command.fileName);
 	}
-	else if (typeStr == "GetScripts") // used only in console commands: .info scripts
+	else if (Command.type == SV4Command::eGetScripts) // used only in console commands: .info scripts
 	{
 		QVariantList Scripts;
 		//for(int i=0; i < d->engine->getScriptCount(); i++)
@@ -345,60 +809,65 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 
 			Scripts.append(Result);
 		}
-		Response["result"] = Scripts;
-		Response["type"] = "QScriptScriptMap";
+		Response.result = Scripts;
+		Response.type = "QScriptScriptMap";
 	}
-	else if (typeStr == "ScriptsCheckpoint")
+	else if (Command.type == SV4Command::eScriptsCheckpoint)
 	{
 		d->previousCheckpointScripts = d->checkpointScripts;
 		d->checkpointScripts.clear();
 		//for(int i=0; i < d->engine->getScriptCount(); i++)
 		//	d->checkpointScripts.insert(i);
-		foreach(const QString& fileName, d->debugger->getCurrentScripts())
-			d->checkpointScripts.insert(d->engine->getScriptId(fileName));
+		foreach(qint64 scriptId, d->debugger->getCurrentScripts()) {
+			if (scriptId != -1)
+				d->checkpointScripts.insert(scriptId);
+		}
 
-		Response["result"] = scriptDelta();
-		Response["type"] = "QScriptScriptsDelta";
+		Response.result = scriptDelta();
+		Response.type = "QScriptScriptsDelta";
 	}
-	else if (typeStr == "GetScriptsDelta")
+	else if (Command.type == SV4Command::eGetScriptsDelta)
 	{
-		Response["result"] = scriptDelta();
-		Response["type"] = "QScriptScriptsDelta";
+		Response.result = scriptDelta();
+		Response.type = "QScriptScriptsDelta";
 	}
 
-	else if (typeStr == "GetBacktrace") // used only in console commands: .backtrace
+	else if (Command.type == SV4Command::eGetBacktrace) // used only in console commands: .backtrace
 	{
-		QVector<QV4::StackFrame> frames = d->debugger->stackTrace();
+		// deep recursion is cut off, only the names of the listed frames are resolved
+		int from = qMax(0, Command.contextIndex);
+		QVector<QV4::StackFrame> frames = d->debugger->stackTrace(from, Command.count > 0 ? Command.count : BACKTRACE_FRAME_LIMIT);
 
 		QStringList Backtrace;
 		foreach(const QV4::StackFrame& entry, frames)
 			Backtrace.append(QString("%1() at %2:%3").arg(entry.function.isEmpty() ? "<anonymous>" : entry.function).arg(QUrl(entry.source).fileName()).arg(entry.line));
-		Response["result"] = Backtrace;
+		Response.result = Backtrace;
+		Response.moreFrames = qMax(0, d->debugger->frameCount() - (from + frames.count()));
 	}
-	else if (typeStr == "GetContextCount") // used only in console commands
+	else if (Command.type == SV4Command::eGetContextCount) // used only in console commands
 	{
-		QVector<QV4::StackFrame> frames = d->debugger->stackTrace();
-
-		Response["result"] = frames.count();
+		Response.result = d->debugger->frameCount();
 	}
 
-	else if (typeStr == "GetContextInfo")
+	else if (Command.type == SV4Command::eGetContextInfo)
 	{
-		QVector<QV4::StackFrame> frames = d->debugger->stackTrace();
+		int frameNr = Command.contextIndex;
+		QVector<QV4::StackFrame> frames = d->debugger->stackTrace(frameNr, 1);
 
-		int frameNr = Attributes["contextIndex"].toInt();
-		if(frameNr >= frames.size())
-			Response["error"] = "InvalidContextIndex";
+		if(frames.isEmpty())
+			Response.error = "InvalidContextIndex";
 		else
 		{
-			QV4::StackFrame& frame = frames[frameNr];
+			QV4::StackFrame& frame = frames[0];
+
+			qint64 scriptId = d->engine->getScriptIdBySource(frame.source);
 
 			QVariantMap Result;
-			Result["scriptId"] = d->engine->getScriptId(QUrl(frame.source).fileName());
+			Result["scriptId"] = scriptId;
 			Result["lineNumber"] = frame.line;
 			Result["columnNumber"] = frame.column;
 
-			Result["fileName"] = QUrl(frame.source).fileName();
+			Result["fileName"] = scriptId != -1 ? d->engine->getScriptName(scriptId) : QUrl(frame.source).fileName();
 			Result["functionName"] = frame.function;
 
 			//QJsonArray scopes;
@@ -414,52 +883,71 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 			//	}
 			//}
 
-			Response["result"] = Result;
-			Response["type"] = "QScriptDebuggerContextInfo";
+			Response.result = Result;
+			Response.type = "QScriptDebuggerContextInfo";
 		}
 	}
-	else if (typeStr == "GetContextState")
+	else if (Command.type == SV4Command::eGetContextState)
 	{
-		//int frameNr = Attributes["contextIndex"].toInt();
-		Response["result"] = d->debugger->engine()->hasException ? 1 : 0;
+		//int frameNr = Command.contextIndex;
+		Response.result = d->debugger->engine()->hasException ? 1 : 0;
 	}
-	else if (typeStr == "GetContextID")
+	else if (Command.type == SV4Command::eGetContextID)
 	{
-		//int frameNr = Attributes["contextIndex"].toInt();
-		Response["result"] = 0;
+		//int frameNr = Command.contextIndex;
+		Response.result = 0;
 	}
-	else if (typeStr == "ContextsCheckpoint")
+	else if (Command.type == SV4Command::eContextsCheckpoint)
 	{
 		QVariantMap Result;
 		Result["added"] = QVariantList();
 		Result["removed"] = QVariantList();
-		Response["result"] = Result;
-		Response["type"] = "QScriptContextsDelta";
+		Response.result = Result;
+		Response.type = "QScriptContextsDelta";
 	}
-	else if (typeStr == "GetThisObject")
+	else if (Command.type == SV4Command::eGetThisObject)
 	{
-		int frameNr = Attributes["contextIndex"].toInt();
+		int frameNr = Command.contextIndex;
 
 		UV4Handle Handle = { 0 };
 		Handle.type = UV4Handle::eThis;
 		Handle.frame = frameNr;
 
-		CV4GetPropsJob job(d->handler, Handle);
-		d->debugger->runJobInEngine(&job);
-		SV4Object object = job.returnValue();
+		bool ok;
+		SV4Object object = inspectObject(Handle.value, &ok);
+		if (!ok) {
+			Response.error = "EngineBusy";
+			return Response;
+		}
 		
 		Handle.type = UV4Handle::eObject;
+		Handle.generation = object.generation;
 		Handle.ref = object.ref;
 
 		QVariantMap Value;
 		Value["type"] = "ObjectValue";
 		Value["value"] = Handle.value;
-		Response["result"] = Value;
-		Response["type"] = "QScriptDebuggerValue";
+		Response.result = Value;
+		Response.type = "QScriptDebuggerValue";
 	}
-	else if (typeStr == "GetScopeChain")
+	else if (Command.type == SV4Command::eReleaseObject)
 	{
-		int frameNr = Attributes["contextIndex"].toInt();
+		UV4Handle Handle = { Command.objectId };
+
+		QSharedPointer<CV4ReleaseJob> job(new CV4ReleaseJob(d->handler, CV4ReleaseJob::eRef, Handle));
+		if (!runInEngine(job))
+			Response.error = "EngineBusy";
+		else if (!job->wasSuccessful())
+			Response.error = "InvalidObjectId";
+	}
+	else if (Command.type == SV4Command::eReleaseObjectGroup)
+	{
+		if (!runInEngine(CV4DebugJobPtr(new CV4ReleaseJob(d->handler, CV4ReleaseJob::eGroup, { 0 }, Command.objectGroup))))
+			Response.error = "EngineBusy";
+	}
+	else if (Command.type == SV4Command::eGetScopeChain)
+	{
+		int frameNr = Command.contextIndex;
 
 		QMap<QString, int> NameCtr;
 
@@ -488,14 +976,14 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 			Result.append(Property);
 		}
 
-		Response["result"] = Result;
-		//Response["type"] = "QScriptDebuggerValueList";
-		Response["type"] = "QScriptDebuggerValuePropertyList";
+		Response.result = Result;
+		//Response.type = "QScriptDebuggerValueList";
+		Response.type = "QScriptDebuggerValuePropertyList";
 	}
 	
-	else if (typeStr == "GetActivationObject") // used only in console commands: .info locals
+	else if (Command.type == SV4Command::eGetActivationObject) // used only in console commands: .info locals
 	{
-		int frameNr = Attributes["contextIndex"].toInt();
+		int frameNr = Command.contextIndex;
 
 		UV4Handle Scope = { 0 };
 		Scope.frame = frameNr;
@@ -512,213 +1000,439 @@ QVariantMap CV4ScriptDebuggerBackend::onCommand(int id, const QVariantMap& Comma
 		Value["type"] = "ObjectValue";
 		Value["value"] = Scope.value;
 
-		Response["result"] = Value;
-		Response["type"] = "QScriptDebuggerValue";
+		Response.result = Value;
+		Response.type = "QScriptDebuggerValue";
 	}
 
-	else if (typeStr == "GetPropertyExpressionValue") // irrelevant used only for tooltips
+	else if (Command.type == SV4Command::eGetPropertyExpressionValue) // irrelevant used only for tooltips
 		; 
-	else if (typeStr == "GetCompletions") // irrelevant used only for autocomplete
+	else if (Command.type == SV4Command::eGetCompletions) // irrelevant used only for autocomplete
 		; 
 		
-	else if (typeStr == "NewScriptObjectSnapshot")
+	else if (Command.type == SV4Command::eNewScriptObjectSnapshot)
 	{
 		int snap_id = d->nextScriptObjectSnapshotId;
 		++d->nextScriptObjectSnapshotId;
-		d->scriptObjectSnapshots.insert(snap_id, new SV4Object());
-		Response["result"] = snap_id;
+		d->scriptObjectSnapshots.insert(snap_id, new SV4ObjectSnapshot());
+		Response.result = snap_id;
 	}
-	else if (typeStr == "ScriptObjectSnapshotCapture")
+	else if (Command.type == SV4Command::eScriptObjectSnapshotCapture)
 	{
-		QVariantMap value = Attributes["scriptValue"].toMap();
-		Q_ASSERT(value["type"] == "ObjectValue"); // as provided by GetScopeChain
-		UV4Handle Handle = { value["value"].toULongLong() };
+		UV4Handle Handle = { Command.objectId };
 
-		int snap_id = Attributes["snapshotId"].toInt();
-		SV4Object* snap = d->scriptObjectSnapshots.value(snap_id);
+		int snap_id = Command.snapshotId;
+		SV4ObjectSnapshot* snap = d->scriptObjectSnapshots.value(snap_id);
 		Q_ASSERT(snap != 0);
 		if (!snap) {
-			Response["error"] = "InvalidArgumentIndex";
+			Response.error = "InvalidArgumentIndex";
+			return Response;
+		}
+		bool ok;
+		SV4Object object = inspectObject(Handle.value, &ok);
+		if (!ok) { // keep the snapshot as it was, the next capture reports the delta
+			Response.error = "EngineBusy";
 			return Response;
 		}
-		snap->handle = Handle;
 
-		CV4GetPropsJob job(d->handler, Handle);
-		d->debugger->runJobInEngine(&job);
-		SV4Object object = job.returnValue();
+		//
+		// Note: one pass over the current properties finds the added and changed ones,
+		//	the previous properties which were not seen are the removed ones
+		//
 
-		QMap<QString, SV4Property> currProps;
-		QHash<QString, int> propertyNameToIndex;
+		QVector<bool> seen(snap->names.size(), false);
+		SV4ObjectSnapshot next;
+		next.handle = Handle;
+		next.entries.reserve(object.properties.size());
+		next.names.reserve(object.properties.size());
+
+		QVariantList changedProperties;
+		QVariantList addedProperties;
 		for (int i = 0; i < object.properties.size(); i++)
 		{
 			const SV4Property& value = object.properties[i];
-			currProps.insert(value.name, value);
-			propertyNameToIndex.insert(value.name, i);
-		}
-
-		QSet<QString> prevSet;
-		for (int i = 0; i < snap->properties.size(); ++i)
-			prevSet.insert(snap->properties.at(i).name);
-		QStringList currProps_keys = currProps.keys();
-		QSet<QString> currSet = QSet<QString>(currProps_keys.begin(), currProps_keys.end());
-		QSet<QString> removedPropertiesSet = prevSet - currSet;
-		QSet<QString> addedPropertiesSet = currSet - prevSet;
-		QSet<QString> maybeChangedPropertiesSet = currSet & prevSet;
-
-		QMap<int, SV4Property> addedPropertiesMap;
-		for (QSet<QString>::const_iterator I = addedPropertiesSet.constBegin(); I != addedPropertiesSet.constEnd(); I++) {
-			int idx = propertyNameToIndex[*I];
-			addedPropertiesMap[idx] = currProps[*I];
-		}
-		
-		QList<SV4Property> changedPropertiesList;
-		for (QSet<QString>::const_iterator I = maybeChangedPropertiesSet.constBegin(); I != maybeChangedPropertiesSet.constEnd(); I++) {
-			const SV4Property& p1 = currProps[*I];
-			SV4Property p2 = SV4Property();
-			for (int i = 0; i < snap->properties.size(); ++i) {
-				if (snap->properties.at(i).name == *I) {
-					p2 = snap->properties.at(i);
-					break;
-				}
+			if (next.entries.contains(value.name))
+				continue; // a duplicate name, the first one wins
+
+			quint64 fingerprint = value.fingerprint();
+			next.entries.insert(value.name, { fingerprint, next.names.size() });
+			next.names.append(value.name);
+
+			auto I = snap->entries.constFind(value.name);
+			if (I == snap->entries.constEnd())
+				addedProperties.append(value.toVariant());
+			else {
+				seen[I->index] = true;
+				if (I->fingerprint != fingerprint)
+					changedProperties.append(value.toVariant());
 			}
+		}
 
-			if (p1.type != p2.type || p1.data != p2.data)
-				changedPropertiesList.append(p1);
+		QStringList removedProperties;
+		for (int i = 0; i < seen.size(); i++) {
+			if (!seen[i])
+				removedProperties.append(snap->names[i]);
 		}
 
-		snap->properties = currProps.values().toVector();
-		
+		*snap = std::move(next);
 
 		QVariantMap result;
-
-		result["removedProperties"] = QStringList(removedPropertiesSet.begin(), removedPropertiesSet.end());
-
-		QVariantList changedProperties;
-		foreach(const SV4Property & value, changedPropertiesList)
-			changedProperties.append(value.toVariant());
+		result["removedProperties"] = removedProperties;
 		result["changedProperties"] = changedProperties;
-
-		QVariantList addedProperties;
-		foreach(const SV4Property& value, addedPropertiesMap)
-			addedProperties.append(value.toVariant());
 		result["addedProperties"] = addedProperties;
 
-		Response["result"] = result;
-		Response["type"] = "QScriptDebuggerObjectSnapshotDelta";
+		Response.result = result;
+		Response.type = "QScriptDebuggerObjectSnapshotDelta";
 	}
-	else if (typeStr == "ScriptValueToString") // used only in console commands
+	else if (Command.type == SV4Command::eScriptValueToString) // used only in console commands
 	{
-		QVariantMap value = Attributes["scriptValue"].toMap();
-		Q_ASSERT(value["type"] == "ObjectValue");
-		UV4Handle Handle = { value["value"].toULongLong() };
+		UV4Handle Handle = { Command.objectId };
 
 		// todo
 
-		Response["result"] = "TODO: not implemented";
+		Response.result = "TODO: not implemented";
 	}
-	else if (typeStr == "NewScriptValueIterator") // used only in console commands
+	else if (Command.type == SV4Command::eNewScriptValueIterator) // used only in console commands
 	{
-		QVariantMap value = Attributes["scriptValue"].toMap();
-		Q_ASSERT(value["type"] == "ObjectValue"); // as provided by GetScopeChain
-		UV4Handle Handle = { value["value"].toULongLong() };
+		UV4Handle Handle = { Command.objectId };
 
 		int iter_id = d->nextScriptValueIteratorId;
 		++d->nextScriptValueIteratorId;
 		SV4ValueIterator* iter = new SV4ValueIterator();
 		d->scriptValueIterators.insert(id, iter);
 
-		CV4GetPropsJob job(d->handler, Handle);
-		d->debugger->runJobInEngine(&job);
-		iter->snapshot = job.returnValue();
+		bool ok;
+		iter->snapshot = inspectObject(Handle.value, &ok);
+		if (!ok)
+			Response.error = "EngineBusy";
 
-		Response["result"] = id;
+		Response.result = id;
 	}
-	else if (typeStr == "DeleteScriptObjectSnapshot")
+	else if (Command.type == SV4Command::eDeleteScriptObjectSnapshot)
 	{
-		int snap_id = Attributes["snapshotId"].toInt();
+		int snap_id = Command.snapshotId;
 		delete d->scriptObjectSnapshots.take(snap_id);
 	}
-	else if(typeStr == "GetPropertiesByIterator") // used only in console commands
+	else if(Command.type == SV4Command::eGetPropertiesByIterator) // used only in console commands
 	{
-		int iter_id = Attributes["iteratorId"].toInt();
+		int iter_id = Command.iteratorId;
 		SV4ValueIterator *iter = d->scriptValueIterators.value(iter_id);
 		Q_ASSERT(iter != 0);
 		if (!iter) {
-			Response["error"] = "InvalidArgumentIndex";
+			Response.error = "InvalidArgumentIndex";
 			return Response;
 		}
 
+		// a positive count returns the properties page by page
+		int end = iter->snapshot.properties.size();
+		if (Command.count > 0)
+			end = qMin(end, iter->index + Command.count);
+
 		QVariantList Result;
-		for(;iter->index < iter->snapshot.properties.size(); iter->index++)
+		for(;iter->index < end; iter->index++)
 			Result.append(iter->snapshot.properties[iter->index].toVariant());
-		Response["result"] = Result;
-		Response["type"] = "QScriptDebuggerValuePropertyList";
+		Response.result = Result;
+		Response.type = "QScriptDebuggerValuePropertyList";
 	}
-	else if(typeStr == "DeleteScriptValueIterator") // used only in console commands
+	else if(Command.type == SV4Command::eDeleteScriptValueIterator) // used only in console commands
 	{
-		int iter_id = Attributes["iteratorId"].toInt();
+		int iter_id = Command.iteratorId;
 		delete d->scriptValueIterators.take(iter_id);
 	}
+	else if (Command.type == SV4Command::eGetPropertyRange)
+	{
+		UV4Handle Handle = { Command.objectId };
+		int filter = Command.filter;
+		qint64 offset = qMax(Command.offset, 0);
+		qint64 count = Command.count;
+
+		//
+		// Note: a bucket is a range of indices of an array, it either splits into smaller buckets
+		//	or reads its indices directly from the array
+		//
+		if (Handle.type == UV4Handle::eBucket)
+		{
+			if (Handle.generation != d->bucketGeneration || Handle.ref >= (uint)d->propertyBuckets.size()) {
+				Response.error = "InvalidObjectId";
+				return Response;
+			}
+			CV4ScriptDebuggerBackendPrivate::SPropertyBucket Bucket = d->propertyBuckets[Handle.ref];
+
+			QVariantMap Result;
+			Result["indexedLength"] = Bucket.to - Bucket.from;
+			if (filter == SV4Command::eNamedProperties)
+				Result["properties"] = QVariantList();
+			else if (Bucket.to - Bucket.from > PROPERTY_BUCKET_SIZE)
+				Result["properties"] = makePropertyBuckets(Bucket.object, Bucket.from, Bucket.to, Command.cdpValues);
+			else
+				Handle.value = Bucket.object;
+
+			if (Result.contains("properties")) {
+				Response.result = Result;
+				Response.type = "V4PropertyRange";
+				return Response;
+			}
+
+			filter = SV4Command::eIndexedProperties;
+			offset = qMin(Bucket.from + offset, Bucket.to);
+			count = count < 0 ? Bucket.to - offset : qMin(count, Bucket.to - offset);
+		}
+
+		QVariantList Properties;
+		qint64 indexedLength = -1;
+		if (Handle.type == UV4Handle::eObject)
+		{
+			QSharedPointer<CV4GetPropertyRangeJob> job(new CV4GetPropertyRangeJob(d->handler, Handle, filter, offset, count, PROPERTY_BUCKET_SIZE));
+			if (!runInEngine(job)) {
+				Response.error = "EngineBusy";
+				return Response;
+			}
+			if (!job->wasSuccessful()) {
+				Response.error = "InvalidObjectId";
+				return Response;
+			}
+
+			indexedLength = job->indexedLength();
+			if (job->isBucketed())
+				Properties = makePropertyBuckets(Handle.value, 0, indexedLength, Command.cdpValues);
+			foreach(const SV4Property& value, job->returnValue())
+				Properties.append(Command.cdpValues ? value.encode<SV4CdpFormat>() : value.encode<SV4LegacyFormat>());
+		}
+		else // scopes and this objects
+		{
+			bool ok;
+			SV4Object object = inspectObject(Handle.value, &ok);
+			if (!ok) {
+				Response.error = "EngineBusy";
+				return Response;
+			}
+
+			if (filter != SV4Command::eIndexedProperties) {
+				qint64 end = count < 0 ? object.properties.size() : qMin<qint64>(object.properties.size(), offset + count);
+				for (qint64 i = offset; i < end; i++)
+					Properties.append(Command.cdpValues ? object.properties[i].encode<SV4CdpFormat>() : object.properties[i].encode<SV4LegacyFormat>());
+			}
+		}
+
+		QVariantMap Result;
+		Result["properties"] = Properties;
+		Result["indexedLength"] = indexedLength;
+		Response.result = Result;
+		Response.type = "V4PropertyRange";
+	}
 	
-	else if (typeStr == "SetScriptValueProperty")
+	else if (Command.type == SV4Command::eSetScriptValueProperty)
 	{
-		QVariantMap value = Attributes["scriptValue"].toMap();
-		Q_ASSERT(value["type"] == "ObjectValue");
-		UV4Handle Handle = { value["value"].toULongLong() };
+		UV4Handle Handle = { Command.objectId };
 
 		SV4Value Value;
-		Value.fromVariant(Attributes["subordinateScriptValue"].toMap());
+		Value.fromVariant(Command.value);
 
-		CV4SetValueJob job(d->handler, Handle, Attributes["name"].toString(), Value);
-		d->debugger->runJobInEngine(&job);
+		if (!runInEngine(CV4DebugJobPtr(new CV4SetValueJob(d->handler, Handle, Command.name, Value))))
+			Response.error = "EngineBusy";
 	}
 
-	else if (typeStr == "ClearExceptions") // used only in console commands
+	else if (Command.type == SV4Command::eClearExceptions) // used only in console commands
 	{
 		d->debugger->engine()->hasException = false;
 	}
+
+	else if (Command.type == SV4Command::eGetCallFrames) // frames past the ones sent with the pause event
+	{
+		if (!d->debugger->isPaused()) {
+			Response.error = "NotPaused";
+			return Response;
+		}
+
+		int frameCount = 0;
+		QVector<SV4CallFrame> callFrames;
+		if (!captureCallFrames(Command.contextIndex, Command.count, callFrames, &frameCount)) {
+			Response.error = "EngineBusy";
+			return Response;
+		}
+
+		QVariantList frames;
+		foreach(const SV4CallFrame& frame, callFrames)
+			frames.append(frame.toVariant());
+
+		QVariantMap Result;
+		Result["callFrames"] = frames;
+		Result["frameCount"] = frameCount;
+		Response.result = Result;
+		Response.type = "V4CallFrames";
+	}
 		
 	else // unknown commands
 	{
 		Q_ASSERT(0);
 	}
 
+	if (cacheable && !Response.isError())
+		d->pauseResults.insert(Key, Response);
 	return Response;
 }
 
-void CV4ScriptDebuggerBackend::attachTo(class CV4EngineItf* engine)
+//
+// Note: with onDemand the engine keeps running at full speed (JIT, no debug hooks) until 
+//	attachAgent is called, e.g. when the first debugging session opens
+//
+void CV4ScriptDebuggerBackend::attachTo(class CV4EngineItf* engine, bool onDemand)
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
 	d->engine = engine;
-	d->debugger = new CV4DebugAgent(engine->self()->handle());
 	d->handler = new CV4DebugHandler(engine->self()->handle(), this);
-	connect(d->debugger, SIGNAL(debuggerPaused(CV4DebugAgent*, int, const QString&, CV4SourceLocation, int )), this, SLOT(debuggerPaused(CV4DebugAgent*, int, const QString&, CV4SourceLocation, int)));
+	d->handler->setWeakRefs(d->weakRefs);
+	d->handler->setPropertyCount(d->propertyCount);
 	connect(d->engine->self(), SIGNAL(evaluateFinished(const QJSValue&)), this, SLOT(evaluateFinished(const QJSValue&)));
 	connect(d->engine->self(), SIGNAL(printTrace(const QString&)), this, SLOT(printTrace(const QString&)));
 	connect(d->engine->self(), SIGNAL(invokeDebugger()), this, SLOT(invokeDebugger()), Qt::BlockingQueuedConnection);
+
+	if (!onDemand)
+		attachAgent(); // installed from within the engine's thread
+}
+
+//
+// Note: weak refs do not keep inspected objects alive, a handle to a collected object becomes invalid
+//
+void CV4ScriptDebuggerBackend::setWeakObjectReferences(bool weak)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->weakRefs = weak;
+	if (d->handler)
+		d->handler->setWeakRefs(weak);
+}
+
+void CV4ScriptDebuggerBackend::setPropertyCounts(bool enabled, bool exact)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->propertyCount = !enabled ? CV4DebugHandler::eNoCount : exact ? CV4DebugHandler::eExactCount : CV4DebugHandler::eFastCount;
+	if (d->handler)
+		d->handler->setPropertyCount(d->propertyCount);
+}
+
+void CV4ScriptDebuggerBackend::setPausedFrameLimit(int maxFrames)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->pausedFrameLimit = maxFrames;
+}
+
+void CV4ScriptDebuggerBackend::setJobTimeout(int msecs)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->jobTimeout = msecs;
+}
+
+void CV4ScriptDebuggerBackend::setEvaluateTimeout(int msecs)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	d->evaluateTimeout = msecs;
+}
+
+bool CV4ScriptDebuggerBackend::isAgentAttached() const
+{
+	Q_D(const CV4ScriptDebuggerBackend);
+
+	return !d->debugger.isNull();
+}
+
+void CV4ScriptDebuggerBackend::createAgent()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (d->installedAgent && d->installedAgent->engine() == d->engine->self()->handle())
+		d->debugger = d->installedAgent; // detached but still installed, attach() wakes it up again
+	else {
+		d->debugger = new CV4DebugAgent(d->engine->self()->handle(), d->engine);
+		d->debugger->moveToThread(d->engine->self()->thread()); // the agent must live in the engine's thread
+		d->installedAgent = d->debugger;
+	}
+	connect(d->debugger, SIGNAL(debuggerPaused(CV4DebugAgent*, int, const QString&, CV4SourceLocation, int )), this, SLOT(debuggerPaused(CV4DebugAgent*, int, const QString&, CV4SourceLocation, int)));
 	d->debugger->setBreakOnException();
+
+	// restore the breakpoints of the previous session
+	for (auto I = d->detachedBreakpoints.constBegin(); I != d->detachedBreakpoints.constEnd(); ++I)
+		d->debugger->setBreakpoint(I.value(), I.key());
+	d->detachedBreakpoints.clear();
+}
+
+bool CV4ScriptDebuggerBackend::captureCallFrames(int from, int count, QVector<SV4CallFrame>& frames, int* frameCount)
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	// one job for all frames, the this objects are only valid during the current pause
+	QSharedPointer<CV4CallFramesJob> job(new CV4CallFramesJob(d->handler, from, count));
+	d->handler->setRefGroup(PAUSE_OBJECT_GROUP);
+	bool success = runInEngine(job);
+	d->handler->setRefGroup(QString());
+	if (!success)
+		return false;
+
+	frames = job->callFrames();
+	for (int i = 0; i < frames.size(); i++) {
+		const QString& source = job->frameSources().at(i);
+		frames[i].scriptId = d->engine->getScriptIdBySource(source);
+		frames[i].fileName = frames[i].scriptId != -1 ? d->engine->getScriptName(frames[i].scriptId) : QUrl(source).fileName();
+	}
+
+	if (frameCount) // counted without resolving the frames that were not requested
+		*frameCount = d->debugger->frameCount();
+	return true;
+}
+
+void CV4ScriptDebuggerBackend::attachAgent()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (d->debugger || !d->engine)
+		return;
+
+	createAgent();
+
+	// the engine may be busy, install the agent from within its own thread once no script is on the stack
+	QMetaObject::invokeMethod(d->debugger, "attach", Qt::QueuedConnection);
+}
+
+void CV4ScriptDebuggerBackend::detachAgent()
+{
+	Q_D(CV4ScriptDebuggerBackend);
+
+	if (!d->debugger)
+		return;
+
+	d->detachedBreakpoints = d->debugger->getBreakpoints();
+
+	// no session is left to use the handed out refs, a busy engine keeps them till the next detach
+	runInEngine(CV4DebugJobPtr(new CV4ReleaseJob(d->handler, CV4ReleaseJob::eAll)));
+	clearPropertyBuckets();
+	clearPauseCache();
+
+	disconnect(d->debugger, nullptr, this, nullptr);
+	d->debugger->detach(); // clears stepping, break on exception and breakpoints and resumes the engine
+	d->debugger = NULL; // stays installed in the engine as a pass through, which disposes of it
 }
 
 void CV4ScriptDebuggerBackend::pause()
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	d->debugger->pause();
+	if (d->debugger)
+		d->debugger->pause();
 }
 
 void CV4ScriptDebuggerBackend::detach()
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	if (!d->debugger)
+	if (!d->engine)
 		return;
 
-	d->debugger->resume(); // clear stepping
-	d->debugger->setBreakOnException(false); // clear break on exception
-	d->debugger->deleteAllBreakpoints(); // clear breakpoints
-	d->debugger->resume(); // final resume
-	d->debugger = NULL; // the engine will dispose of the debugger
+	detachAgent();
+	d->detachedBreakpoints.clear();
 
 	delete d->handler;
 	d->handler = NULL;
@@ -734,27 +1448,37 @@ void CV4ScriptDebuggerBackend::debuggerPaused(CV4DebugAgent* debugger, int reaso
 
 	Q_ASSERT(debugger == d->debugger);
 
-	QVariantMap Event;
-	QVariantMap Attributes;
+	clearPauseCache(); // a new pause
+	d->pauseId++;
+
+	SV4Event Event;
 	switch (reason)
 	{
-	case CV4DebugAgent::PauseRequest:	Event["type"] = "Interrupted"; break;
+	case CV4DebugAgent::PauseRequest:	Event.type = SV4Event::eInterrupted; break;
 	case CV4DebugAgent::BreakPointHit:	{
-							Event["type"] = "Breakpoint";
+							Event.type = SV4Event::eBreakpoint;
 							QString breakPointIdStr = fileName + ":" + QString::number(lineNumber);
 							DEBUG_LOG << "XXX breakPointId " << breakPointIdStr;
-							Attributes["breakPointId"] = d->filenameAndBreakpointToBreakpointId.value(breakPointIdStr, -1);
+							Event.breakpointId = d->filenameAndBreakpointToBreakpointId.value(breakPointIdStr, -1);
 							break;
 						}
-	case CV4DebugAgent::Stepped:		Event["type"] = "SteppingFinished"; break; 
-	case CV4DebugAgent::LocationReached:Event["type"] = "LocationReached"; break;
-	case CV4DebugAgent::DebuggerInvoked:Event["type"] = "DebuggerInvocationRequest"; break;
-	case CV4DebugAgent::Exception:		Event["type"] = "Exception"; break;
+	case CV4DebugAgent::Stepped:		Event.type = SV4Event::eSteppingFinished; break; 
+	case CV4DebugAgent::LocationReached:Event.type = SV4Event::eLocationReached; break;
+	case CV4DebugAgent::DebuggerInvoked:Event.type = SV4Event::eDebuggerInvocationRequest; break;
+	case CV4DebugAgent::Exception:		Event.type = SV4Event::eException; break;
+	}
+	Event.scriptId = d->engine->getScriptIdBySource(fileName);
+	Event.fileName = Event.scriptId != -1 ? d->engine->getScriptName(Event.scriptId) : QUrl(fileName).fileName();
+	Event.lineNumber = lineNumber;
+	Event.columnNumber = location.column;
+
+	// the engine waits in signalAndWait, so the whole paused state costs a single job
+	Event.pauseId = d->pauseId;
+	if (d->pausedFrameLimit > 0 && d->debugger->isPaused()) {
+		// the event goes out without frames if the job fails
+		if (captureCallFrames(0, d->pausedFrameLimit, Event.callFrames, &Event.frameCount) && !Event.callFrames.isEmpty())
+			Event.callFrames[0].columnNumber = location.column;
 	}
-	Attributes["scriptId"] = d->engine->getScriptId(QUrl(fileName).fileName());
-	Attributes["fileName"] = QUrl(fileName).fileName();
-	Attributes["lineNumber"] = lineNumber;
-	Attributes["columnNumber"] = location.column;
 
 	if (reason == CV4DebugAgent::Exception) 
 	{
@@ -766,10 +1490,10 @@ void CV4ScriptDebuggerBackend::debuggerPaused(CV4DebugAgent* debugger, int reaso
 		QV4::ScopedValue prim(scope, QV4::RuntimeHelpers::toPrimitive(scope.engine->exceptionValue->asReturnedValue(), QV4::STRING_HINT));
 		scope.engine->hasException = hadException;
         if (prim->isPrimitive())
-            Attributes["message"] = prim->toQStringNoThrow();
-		//Attributes["message"] = scope.engine->exceptionValue->toQStringNoThrow(); // warning this clears the exception
-		Attributes["value"] = d->engine->self()->toScriptValue(scope.engine->exceptionValue->asReturnedValue()).toVariant();
-		Attributes["hasExceptionHandler"] = true; // todo
+            Event.message = prim->toQStringNoThrow();
+		//Event.message = scope.engine->exceptionValue->toQStringNoThrow(); // warning this clears the exception
+		Event.value = d->engine->self()->toScriptValue(scope.engine->exceptionValue->asReturnedValue()).toVariant();
+		Event.hasExceptionHandler = true; // todo
 #else
 		if (scope.engine->exceptionValue) 
 		{
@@ -779,18 +1503,17 @@ void CV4ScriptDebuggerBackend::debuggerPaused(CV4DebugAgent* debugger, int reaso
 			QV4::ScopedValue prim(scope,QV4::RuntimeHelpers::toPrimitive(QV4::Value::fromReturnedValue(exceptionRV), QV4::STRING_HINT));
 			scope.engine->hasException = hadException;
 			if (prim->isPrimitive())
-				Attributes["message"] = prim->toQStringNoThrow();
-			Attributes["value"] = d->engine->self()->toScriptValue(QV4::Value::fromReturnedValue(exceptionRV)).toVariant();
-			Attributes["hasExceptionHandler"] = true;
+				Event.message = prim->toQStringNoThrow();
+			Event.value = d->engine->self()->toScriptValue(QV4::Value::fromReturnedValue(exceptionRV)).toVariant();
+			Event.hasExceptionHandler = true;
 		}
 		else
-			Attributes["hasExceptionHandler"] = false;
+			Event.hasExceptionHandler = false;
 #endif
 	}
-	Event["attributes"] = Attributes;
 
-	DEBUG_LOG << "XXX Event: " << dumpVariant(Event);
-	d->pendingEvents.append(Event);
+	DEBUG_LOG << "XXX Event: " << SV4Event::typeName(Event.type);
+	d->pendingEvents.append(std::move(Event));
 	emit newV4EventAvailable(d->pendingEvents.size());
 }
 
@@ -810,15 +1533,12 @@ void CV4ScriptDebuggerBackend::evalFinished(const QVariant& Value, const QString
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	QVariantMap Event;
-	Event["type"] = "InlineEvalFinished";
-	QVariantMap Attributes;
-	Attributes["value"] = Value;
-	Attributes["isNestedEvaluate"] = true; // = d->debugger->isPaused(); // then this is false, the gui will issue a resume isntruction
-	Attributes["message"] = Message;
-	Event["attributes"] = Attributes;
+	SV4Event Event(SV4Event::eInlineEvalFinished);
+	Event.value = Value;
+	Event.isNestedEvaluate = true; // = d->debugger->isPaused(); // then this is false, the gui will issue a resume isntruction
+	Event.message = Message;
 
-	d->pendingEvents.append(Event);
+	d->pendingEvents.append(std::move(Event));
 	emit newV4EventAvailable(d->pendingEvents.size());
 }
 
@@ -826,13 +1546,10 @@ void CV4ScriptDebuggerBackend::printTrace(const QString& Message)
 {
 	Q_D(CV4ScriptDebuggerBackend);
 
-	QVariantMap Event;
-	Event["type"] = "Trace";
-	QVariantMap Attributes;
-	Attributes["message"] = Message;
-	Event["attributes"] = Attributes;
+	SV4Event Event(SV4Event::eTrace);
+	Event.message = Message;
 
-	d->pendingEvents.append(Event);
+	d->pendingEvents.append(std::move(Event));
 	emit newV4EventAvailable(d->pendingEvents.size());
 }
 
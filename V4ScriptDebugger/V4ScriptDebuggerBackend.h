@@ -30,6 +30,7 @@
 
 #include <QJSEngine>
 #include "V4DebugAgent.h"
+#include "V4DebugProtocol.h"
 
 
 class CV4ScriptDebuggerBackendPrivate;
@@ -43,27 +44,57 @@ public:
 	QVariant handleRequest(const QVariant& var);
 
 	QVariantMap onCommand(int id, const QVariantMap& Command);
-	void attachTo(class CV4EngineItf* engine);
+	SV4Result onCommand(int id, const SV4Command& Command);
+	QList<SV4Result> onCommands(const QList<QPair<int, SV4Command>>& Commands);
+	QList<SV4Event> takeEvents(int max = 0); // 0 takes all
+	void attachTo(class CV4EngineItf* engine, bool onDemand = false);
+	bool isAgentAttached() const;
+	void setWeakObjectReferences(bool weak);
+	// pause events carry up to maxFrames call frames with their this objects and scope chains, 0 disables it
+	void setPausedFrameLimit(int maxFrames);
+	// inspections of a running engine fail with "EngineBusy" if it does not reach a safepoint within msecs
+	void setJobTimeout(int msecs);
+	// evaluations are interrupted after msecs unless the command asks for less, 0 means unlimited
+	void setEvaluateTimeout(int msecs);
+	// object values report their property count estimated from their layout, exact counts enumerate every object value
+	void setPropertyCounts(bool enabled, bool exact = false);
 
 signals:
 	void sendResponse(const QVariant& var);
 	void newV4EventAvailable(const int noOfPendingEvents);
+	void sendResult(int id, const SV4Result& result);
+	void sendEvents(const QList<SV4Event>& events);
 
 public slots:
 	void pause();
 	void detach();
+	void attachAgent();
+	void detachAgent();
 	void processRequest(const QVariant& var);
+	void processCommand(int id, const SV4Command& command);
+	void pullEvents(int max);
 
 private slots:
     void debuggerPaused(CV4DebugAgent* debugger, int reason, const QString& fileName, CV4SourceLocation location, int lineNumber);
     void evaluateFinished(const QJSValue& ret);
     void printTrace(const QString& Message);
 	void invokeDebugger();
+	void processQueuedCommands();
 
 protected:
 	virtual QVariant handleCustom(const QVariant& var) {return QVariant();}
 	virtual void requestStart() {}
 
+	void createAgent();
+	bool captureCallFrames(int from, int count, QVector<SV4CallFrame>& frames, int* frameCount);
+	struct SV4Object inspectObject(quint64 handle, bool* ok = nullptr);
+	bool runInEngine(const QList<CV4DebugJobPtr>& jobs);
+	bool runInEngine(const CV4DebugJobPtr& job) { return runInEngine(QList<CV4DebugJobPtr>() << job); }
+	QString runEvaluation(const CV4DebugJobPtr& job, int timeout);
+	QVariantList makePropertyBuckets(quint64 object, qint64 from, qint64 to, bool cdp);
+	void clearPropertyBuckets();
+	void clearPauseCache();
+
     void evalFinished(const QVariant& Value, const QString& Message = QString());
 	
     QVariantMap scriptDelta();
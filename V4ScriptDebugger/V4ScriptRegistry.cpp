@@ -0,0 +1,95 @@
+/****************************************************************************
+**
+** Copyright (C) 2023-2025 David Xanatos (xanasoft.com) All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+**
+** To use the V4ScriptTools in a commercial project, you must obtain
+** an appropriate business use license.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#include "V4ScriptRegistry.h"
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ScriptRegistry
+//
+
+CV4ScriptRegistry::CV4ScriptRegistry()
+{
+}
+
+CV4ScriptRegistry::~CV4ScriptRegistry()
+{
+    for (int i = 0; i < count(); i++)
+        delete m_entries[i].loadRelaxed();
+    qDeleteAll(m_retired);
+}
+
+qint64 CV4ScriptRegistry::append(const QString& name, int lineNumber, const QString& source)
+{
+    int scriptId = m_count.loadRelaxed();
+    if (!m_entries.reserve(scriptId))
+        return -1;
+
+    m_entries[scriptId].storeRelaxed(new SV4ScriptEntry{ name, lineNumber, source });
+    m_count.storeRelease(scriptId + 1); // publish
+
+    reclaim();
+    return scriptId;
+}
+
+void CV4ScriptRegistry::drop(qint64 scriptId)
+{
+    Q_ASSERT(scriptId >= 0 && scriptId < count());
+
+    const SV4ScriptEntry* entry = m_entries[scriptId].fetchAndStoreOrdered(nullptr);
+    if (!entry)
+        return;
+    m_retired.append(entry);
+
+    int index = m_dropCount.loadRelaxed();
+    if (m_drops.reserve(index)) {
+        m_drops[index] = scriptId;
+        m_dropCount.storeRelease(index + 1); // publish
+    }
+
+    reclaim();
+}
+
+void CV4ScriptRegistry::reclaim()
+{
+    //
+    // Note: the read-modify-write on m_readers orders it with the readers' increments,
+    //  a reader entering after this sees the entries already replaced with nullptr
+    //
+
+    if (!m_retired.isEmpty() && m_readers.fetchAndAddOrdered(0) == 0) {
+        qDeleteAll(m_retired);
+        m_retired.clear();
+    }
+}
+
+bool CV4ScriptRegistry::get(qint64 scriptId, SV4ScriptEntry& entry) const
+{
+    if (scriptId < 0 || scriptId >= count())
+        return false;
+
+    m_readers.fetchAndAddOrdered(1);
+    const SV4ScriptEntry* cur = m_entries[scriptId].loadAcquire();
+    if (cur)
+        entry = *cur; // only shares the string data
+    m_readers.fetchAndAddOrdered(-1);
+    return cur != nullptr;
+}
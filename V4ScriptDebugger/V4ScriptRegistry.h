@@ -0,0 +1,120 @@
+/****************************************************************************
+**
+** Copyright (C) 2023-2025 David Xanatos (xanasoft.com) All rights reserved.
+** Contact: XanatosDavid@gmil.com
+**
+**
+** To use the V4ScriptTools in a commercial project, you must obtain
+** an appropriate business use license.
+**
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU General
+** Public License version 3.0 as published by the Free Software Foundation
+** and appearing in the file LICENSE.GPL included in the packaging of this
+** file. Please review the following information to ensure the GNU General
+** Public License version 3.0 requirements will be met:
+** http://www.gnu.org/copyleft/gpl.html.
+**
+**
+**
+****************************************************************************/
+
+#ifndef CV4SCRIPTREGISTRY_H
+#define CV4SCRIPTREGISTRY_H
+
+#include <QString>
+#include <QList>
+#include <QtCore/qatomic.h>
+#include <QtCore/qalgorithms.h>
+
+// immutable once published
+struct SV4ScriptEntry
+{
+    QString Name;
+    int LineNumber = 0;
+    QString Source;
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ChunkedArray
+//
+// Chunk k holds 256 << k elements, so elements never move and 24 chunks cover any script count
+//
+
+template <typename T>
+class CV4ChunkedArray
+{
+public:
+    enum { FirstChunkBits = 8, MaxChunks = 24 };
+
+    CV4ChunkedArray() { for (int k = 0; k < MaxChunks; k++) m_chunks[k] = nullptr; }
+    ~CV4ChunkedArray() { for (int k = 0; k < MaxChunks; k++) delete[] m_chunks[k]; }
+
+    // the chunk of an index below the published count is always allocated
+    T& operator[](quint32 i) const
+    {
+        quint32 n = i + (1u << FirstChunkBits);
+        int k = (31 - qCountLeadingZeroBits(n)) - FirstChunkBits;
+        return m_chunks[k][n - (1u << (k + FirstChunkBits))];
+    }
+
+    // writer only, must be called before the index is published
+    bool reserve(quint32 i)
+    {
+        quint32 n = i + (1u << FirstChunkBits);
+        int k = (31 - qCountLeadingZeroBits(n)) - FirstChunkBits;
+        if (k >= MaxChunks)
+            return false;
+        if (!m_chunks[k])
+            m_chunks[k] = new T[1u << (k + FirstChunkBits)]();
+        return true;
+    }
+
+private:
+    Q_DISABLE_COPY(CV4ChunkedArray)
+    T* m_chunks[MaxChunks];
+};
+
+////////////////////////////////////////////////////////////////////////////////////
+// CV4ScriptRegistry
+//
+// Single writer (the engine's thread), any number of lock-free readers.
+// Entries are appended and published through an atomic count, a dropped entry is replaced
+// by nullptr and recorded in the drop log, it is freed once no reader can still see it.
+//
+
+class CV4ScriptRegistry
+{
+public:
+    CV4ScriptRegistry();
+    ~CV4ScriptRegistry();
+
+    // writer
+    qint64 append(const QString& name, int lineNumber, const QString& source);
+    void drop(qint64 scriptId);
+
+    // readers
+    int count() const { return m_count.loadAcquire(); }
+    bool get(qint64 scriptId, SV4ScriptEntry& entry) const;
+
+    int dropCount() const { return m_dropCount.loadAcquire(); }
+    qint64 droppedAt(int index) const { return m_drops[index]; }
+
+protected:
+    void reclaim();
+
+    CV4ChunkedArray<QAtomicPointer<const SV4ScriptEntry>> m_entries;
+    QAtomicInt m_count;
+
+    CV4ChunkedArray<qint64> m_drops;
+    QAtomicInt m_dropCount;
+
+    mutable QAtomicInt m_readers;
+    QList<const SV4ScriptEntry*> m_retired; // writer only
+
+private:
+    Q_DISABLE_COPY(CV4ScriptRegistry)
+};
+
+#endif
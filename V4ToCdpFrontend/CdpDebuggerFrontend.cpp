@@ -16,6 +16,10 @@
 #include <QVariant>
 #include <QDebug>
 #include <QStringList>
+#include <QTimer>
+#include <QUrlQuery>
+
+#include <limits>
 
 // DEBUG_LOGGING_ENABLED via CMake needs to be enabled to spill out stuff. See debug_out.h for more
 #include "debug_out.h"
@@ -25,6 +29,17 @@
 #include "V4CdpHelper.h"
 #include "V4Helpers.h"
 
+// upper bound of events fetched per drain, keeps a flood of traces from stalling the event loop
+#define MAX_EVENTS_PER_DRAIN 256
+
+// defaults for the pending request table, see setRequestLimits()
+#define CDP_REQUEST_TIMEOUT 30000
+#define MAX_PENDING_CDP_REQUESTS 1024
+
+// per client outbound limits, see setBackpressure()
+#define SOCKET_HIGH_WATER (256 * 1024)
+#define MAX_QUEUED_BYTES (16 * 1024 * 1024)
+
 // some helper functions
 static std::string variantMapToJsonString(const QVariantMap& map, bool compact = true) {
     QJsonObject obj = QJsonObject::fromVariantMap(map);
@@ -37,6 +52,13 @@ static std::string variantMapToJsonString(const QVariantMap& map, bool compact =
     return jsonString.toStdString();
 }
 
+// high volume events without state the client depends on, they may be dropped when a client falls behind
+static bool isDroppableEvent(const QString& method)
+{
+    return method == "Runtime.consoleAPICalled"
+        || method == "Console.messageAdded";
+}
+
 // CdpDebuggerFrontend implementation
 CdpDebuggerFrontend::CdpDebuggerFrontend(
     BackendSyncCall getHandledByBackend,
@@ -45,8 +67,16 @@ CdpDebuggerFrontend::CdpDebuggerFrontend(
     : QObject(parent),
       m_getHandledByBackend(std::move(getHandledByBackend)),
       m_frontendName(frontendName),
-      m_httpServer(nullptr)
+      m_httpServer(nullptr),
+      m_requestTimeout(CDP_REQUEST_TIMEOUT),
+      m_maxPendingRequests(MAX_PENDING_CDP_REQUESTS),
+      m_maxQueuedBytes(MAX_QUEUED_BYTES)
 {
+    m_clock.start();
+
+    m_expireTimer = new QTimer(this);
+    m_expireTimer->setInterval(1000);
+    connect(m_expireTimer, &QTimer::timeout, this, &CdpDebuggerFrontend::expirePendingRequests);
 }
 
 CdpDebuggerFrontend::~CdpDebuggerFrontend()
@@ -56,6 +86,24 @@ CdpDebuggerFrontend::~CdpDebuggerFrontend()
     }
 }
 
+void CdpDebuggerFrontend::setTypedBackend(V4CommandCall commandCall)
+{
+    m_commandCall = std::move(commandCall);
+    m_typedBackend = (bool)m_commandCall;
+}
+
+void CdpDebuggerFrontend::setRequestLimits(int timeoutMs, int maxPending)
+{
+    m_requestTimeout = timeoutMs;
+    m_maxPendingRequests = maxPending;
+}
+
+void CdpDebuggerFrontend::setBackpressure(qint64 maxQueuedBytes, BackpressurePolicy policy)
+{
+    m_maxQueuedBytes = maxQueuedBytes;
+    m_backpressurePolicy = policy;
+}
+
 void CdpDebuggerFrontend::startServer(quint16 port)
 {
     if (m_httpServer)
@@ -100,6 +148,21 @@ void CdpDebuggerFrontend::onNewWebSocketConnection()
         }
 
         m_responseClients.append(client);
+        m_outbound.insert(client, SOutboundQueue());
+
+        // a client may ask for a tighter evaluation budget than the frontend's, never for a longer one
+        int budget = m_evaluateBudget;
+        bool ok = false;
+        int requested = QUrlQuery(client->requestUrl()).queryItemValue("evaluateBudget").toInt(&ok);
+        if (ok && requested > 0 && (budget <= 0 || requested < budget))
+            budget = requested;
+        m_sessionBudgets.insert(client, budget);
+
+        if (m_attachOnDemand && m_responseClients.size() == 1) {
+            QVariantMap v4Req{{"Control", "AttachAgent"}};
+            blockingV4BackendCall(v4Req);
+            DEBUG_LOG << "XXX first CDP client connected, debug agent attached";
+        }
 
         connect(client, &QWebSocket::textMessageReceived,
                 this, [this, client](const QString &msg){ onCdpMessageReceived(msg, client); });
@@ -107,6 +170,15 @@ void CdpDebuggerFrontend::onNewWebSocketConnection()
                 this, [this, client](){
                     onCdpDisconnected(client);
                 });
+        connect(client, &QWebSocket::bytesWritten,
+                this, [this, client](qint64 bytes){
+                    auto it = m_outbound.find(client);
+                    if (it == m_outbound.end())
+                        return;
+                    it->inFlight = qMax<qint64>(0, it->inFlight - bytes);
+                    if (!it->messages.isEmpty())
+                        scheduleFlush();
+                });
 
         sendInitialEvents(client);
     }
@@ -234,43 +306,43 @@ void CdpDebuggerFrontend::onCdpMessageReceived(const QString& message, QWebSocke
 
         QString method = cmd["method"].toString();
         DEBUG_LOG << "Processing CDP command:" << method << " with id:" << id;
+        // resolved once, the mapper keeps it with the pending request
+        V4CdpMapper::CdpMethod cdpMethod = V4CdpMapper::findMethod(method);
+
         // Immediate responses (no backend)
-        if (method == "Runtime.enable") {
-            QJsonObject response{
-                {"id", id},
-                {"result", QJsonObject()}
-            };
-            sendToClient(client, QJsonDocument(response));
-            return;
-        } else if (method == "Debugger.enable") {
-            QJsonObject response{
-                {"id", id},
-                {"result", QJsonObject{{"debuggerId", QString("%1-debugger-1").arg(m_frontendName.toLower())}}}
-            };
-            sendToClient(client, QJsonDocument(response));
+        if (V4CdpMapper::methodFlags(cdpMethod) & V4CdpMapper::CdpImmediate) {
+            QJsonObject result;
+            if (cdpMethod == V4CdpMapper::DebuggerEnable)
+                result["debuggerId"] = QString("%1-debugger-1").arg(m_frontendName.toLower());
 
-            createAndSentScriptParsedEvents(client);
-            return;
-        } else if (method == "Debugger.disable") {
             QJsonObject response{
                 {"id", id},
-                {"result", QJsonObject()}
+                {"result", result}
             };
             sendToClient(client, QJsonDocument(response));
+
+            if (cdpMethod == V4CdpMapper::DebuggerEnable)
+                createAndSentScriptParsedEvents(client);
             return;
         }
 
         // Map to V4 Command (type, attributes)
-        QVariantMap cdpReq = cmd.toVariantMap();
-        QVariantMap v4Map = V4CdpMapper::mapCdpToV4Request(cdpReq);
-        if (v4Map.contains(MAPPER_PASSTHROUGH) && v4Map.value(MAPPER_PASSTHROUGH).toBool()) {
-            QVariantMap cdpResponse = V4CdpMapper::mapV4ToCdpResponse(v4Map);
+        QVariantMap params = cmd["params"].toObject().toVariantMap();
+        SV4MappedRequest v4Request;
+        bool mapped = V4CdpMapper::mapCdpToV4Request(cdpMethod, params, v4Request);
+        if (mapped && v4Request.passthrough) {
+            QVariantMap cdpResponse = V4CdpMapper::mapV4ToCdpResponse(id, cdpMethod, params, SV4Result());
             sendToClient(client, QJsonDocument::fromVariant(cdpResponse));
         }
 
-        else if (!v4Map.isEmpty()) {
-            QVariant v4Request = QVariant::fromValue(v4Map);
-            wrapperSendRequestToBackend(v4Request);
+        else if (mapped) {
+            SV4Command& command = v4Request.command;
+            int budget = m_sessionBudgets.value(client);
+            if (command.type == SV4Command::eEvaluate && budget > 0 && (command.timeout <= 0 || command.timeout > budget))
+                command.timeout = budget;
+
+            int sequence = addPendingRequest(client, id, cdpMethod, params);
+            wrapperSendCommandToBackend(sequence, v4Request.command);
             DEBUG_LOG << "Forwarded CDP command to backend:" << method;
         } else {
             qWarning() << "Failed to map CDP command to V4:" << method;
@@ -293,6 +365,15 @@ void CdpDebuggerFrontend::wrapperSendRequestToBackend(const QVariant& request)
     emit sendRequestToBackend(request);
 }
 
+void CdpDebuggerFrontend::wrapperSendCommandToBackend(int id, const SV4Command& command)
+{
+    DEBUG_LOG << "XXX <-- V4 sending command to backend:" << id << SV4Command::typeName(command.type);
+    if (m_typedBackend)
+        emit sendCommandToBackend(id, command);
+    else
+        emit sendRequestToBackend(QVariantMap{{"ID", id}, {"Command", command.toVariant()}});
+}
+
 void CdpDebuggerFrontend::onCdpDisconnected(QWebSocket *client)
 {
     if (!client)
@@ -302,10 +383,27 @@ void CdpDebuggerFrontend::onCdpDisconnected(QWebSocket *client)
     // Mark for async deletion
     client->deleteLater();
 
-    // Remove all now-invalid pointers
-    m_responseClients.removeIf([](const QPointer<QWebSocket> &ptr) {
-        return ptr.isNull();
+    // Remove the client and all now-invalid pointers
+    m_responseClients.removeIf([client](const QPointer<QWebSocket> &ptr) {
+        return ptr.isNull() || ptr == client;
     });
+
+    m_outbound.remove(client);
+    m_sessionBudgets.remove(client);
+
+    // nobody is left to receive these responses, late results are dropped as unknown
+    for (auto it = m_pendingAge.begin(); it != m_pendingAge.end(); ) {
+        int sequence = *it++;
+        const SPendingRequest& request = m_pendingRequests[sequence];
+        if (request.client.isNull() || request.client == client)
+            takePendingRequest(sequence);
+    }
+
+    if (m_attachOnDemand && m_responseClients.isEmpty()) {
+        QVariantMap v4Req{{"Control", "DetachAgent"}};
+        blockingV4BackendCall(v4Req);
+        DEBUG_LOG << "XXX last CDP client disconnected, debug agent detached";
+    }
 }
 
 
@@ -321,24 +419,14 @@ void CdpDebuggerFrontend::onBackendResponse(const QVariant& response)
     int id = v4Response.value("ID", -1).toInt();  // V4 Backend uses "ID" (uint)
 
     if (id == -1) { // assuming we are in event notification mode
-        if (v4Response.contains("Event")) {
-            if (autoReplyForSomeEvents(v4Response))
-                return;
-            QVariantMap cdpEvent = V4CdpMapper::mapV4EventToCdp(v4Response, m_getHandledByBackend);
-            DEBUG_LOG << "XXX Result of V4CdpMapper::mapV4EventToCdp " << dumpVariant(cdpEvent);
-            if (!cdpEvent.isEmpty()) {
-                DEBUG_LOG << "XXX clients are like going crazy: " << m_responseClients.size();
-                for (QPointer<QWebSocket> &client : m_responseClients) {
-                    if (!client) {
-                        DEBUG_LOG << "XXX invalid client entry";
-                        continue;
-                    }
-                    sendToClient(client, QJsonDocument::fromVariant(cdpEvent));
-                }
-
-            } else {
-                qWarning() << "Failed to map V4 event to CDP";
-            }
+        if (v4Response.contains("Events")) {
+            QList<SV4Event> events;
+            for (const QVariant& event : v4Response.value("Events").toList())
+                events.append(SV4Event::fromVariant(event.toMap()));
+            onBackendEvents(events);
+        }
+        else if (v4Response.contains("Event")) {
+            processV4Event(SV4Event::fromVariant(v4Response.value("Event").toMap()));
         }
         else {
             qWarning() << "Backend response missing ID";
@@ -347,36 +435,126 @@ void CdpDebuggerFrontend::onBackendResponse(const QVariant& response)
         return;
     }
 
+    onBackendResult(id, SV4Result::fromVariant(v4Response.value("Result").toMap()));
+}
+
+void CdpDebuggerFrontend::onBackendResult(int id, const SV4Result& result)
+{
+    if (!m_pendingRequests.contains(id)) {
+        qWarning() << "Backend result for unknown or expired request" << id;
+        return;
+    }
+    SPendingRequest request = takePendingRequest(id);
+
     // Map V4 to CDP non-event messages
-    QVariantMap cdpResp = V4CdpMapper::mapV4ToCdpResponse(v4Response);
+    QVariantMap cdpResp = V4CdpMapper::mapV4ToCdpResponse(request.cdpId, request.method, request.params, result);
 
-    for (QPointer<QWebSocket> &client : m_responseClients) {
-        if (!client) {
-            DEBUG_LOG << "XXX invalid client entry";
-            continue;
-        }
-        sendToClient(client, QJsonDocument::fromVariant(cdpResp));
+    // only the client which made the request gets the response
+    if (!request.client) {
+        DEBUG_LOG << "XXX client of request" << id << "is gone";
+        return;
     }
+    sendToClient(request.client, QJsonDocument::fromVariant(cdpResp));
 
     DEBUG_LOG << "Sent backend response to client for ID:" << id;
 }
 
-bool CdpDebuggerFrontend::autoReplyForSomeEvents(QVariantMap &v4Resp)
+int CdpDebuggerFrontend::addPendingRequest(QWebSocket* client, int cdpId, V4CdpMapper::CdpMethod method, const QVariantMap& params)
+{
+    // beyond the cap the oldest requests are given up on
+    while (m_maxPendingRequests > 0 && m_pendingRequests.size() >= m_maxPendingRequests)
+        failPendingRequest(m_pendingAge.front(), "Too many pending requests");
+
+    // after a wrap around a very old request may still hold the number
+    do {
+        if (m_lastSequence == std::numeric_limits<int>::max())
+            m_lastSequence = 0;
+    } while (m_pendingRequests.contains(++m_lastSequence));
+    int sequence = m_lastSequence;
+
+    SPendingRequest& request = m_pendingRequests[sequence];
+    request.age = m_pendingAge.insert(m_pendingAge.end(), sequence);
+    request.client = client;
+    request.cdpId = cdpId;
+    request.method = method;
+    request.params = params;
+    request.deadline = m_requestTimeout > 0 ? m_clock.elapsed() + m_requestTimeout : std::numeric_limits<qint64>::max();
+
+    if (m_requestTimeout > 0 && !m_expireTimer->isActive())
+        m_expireTimer->start();
+    return sequence;
+}
+
+CdpDebuggerFrontend::SPendingRequest CdpDebuggerFrontend::takePendingRequest(int sequence)
+{
+    SPendingRequest request = m_pendingRequests.take(sequence);
+    m_pendingAge.erase(request.age);
+    return request;
+}
+
+void CdpDebuggerFrontend::failPendingRequest(int sequence, const QString& message)
 {
-    if (V4Helpers::getNestedValue(v4Resp, {"Event", "type"}).toString() == "InlineEvalFinished" &&
-        V4Helpers::getNestedValue(v4Resp, {"Event", "attributes", "message"}).toString() == "undefined")
+    SPendingRequest request = takePendingRequest(sequence);
+    DEBUG_LOG << "XXX failing pending request" << sequence << "with CDP id" << request.cdpId << ":" << message;
+
+    QJsonObject errorResp{
+        {"id", request.cdpId},
+        {"error", QJsonObject{
+            {"code", -32000},
+            {"message", message}
+        }}
+    };
+    if (request.client)
+        sendToClient(request.client, QJsonDocument(errorResp));
+}
+
+void CdpDebuggerFrontend::expirePendingRequests()
+{
+    // all requests get the same timeout, so the oldest one expires first
+    qint64 now = m_clock.elapsed();
+    while (!m_pendingAge.empty() && m_pendingRequests[m_pendingAge.front()].deadline <= now)
+        failPendingRequest(m_pendingAge.front(), "Request timed out");
+
+    if (m_pendingRequests.isEmpty())
+        m_expireTimer->stop();
+}
+
+void CdpDebuggerFrontend::onBackendEvents(const QList<SV4Event>& events)
+{
+    for (const SV4Event& event : events)
+        processV4Event(event);
+    if (events.size() == MAX_EVENTS_PER_DRAIN) // there may be more
+        onV4EventAvailable(-1);
+}
+
+void CdpDebuggerFrontend::processV4Event(const SV4Event& v4Event)
+{
+    if (autoReplyForSomeEvents(v4Event))
+        return;
+    QVariantMap cdpEvent = V4CdpMapper::mapV4EventToCdp(v4Event,
+        [this](int, const SV4Command& command) { return blockingV4BackendCommand(command); });
+    DEBUG_LOG << "XXX Result of V4CdpMapper::mapV4EventToCdp " << dumpVariant(cdpEvent);
+    if (!cdpEvent.isEmpty()) {
+        DEBUG_LOG << "XXX clients are like going crazy: " << m_responseClients.size();
+        broadcastToClients(cdpEvent);
+    } else {
+        qWarning() << "Failed to map V4 event to CDP";
+    }
+}
+
+bool CdpDebuggerFrontend::autoReplyForSomeEvents(const SV4Event &v4Event)
+{
+    if (v4Event.type == SV4Event::eInlineEvalFinished && v4Event.message == "undefined")
     {
         // automatically resume if no clients are connected (avoid paused state)
-        QVariantMap v4Req;
-        v4Req["Command"] = QVariantMap{
-            {"type", "Resume"},
-            {"attributes", QVariantMap{}}};
-        blockingV4BackendCall(v4Req);
-        DEBUG_LOG << "XXX --> V4 Event: auto handled event: " << dumpVariant(v4Resp, 2) << " with here generated answer: " << dumpVariant(v4Req, 2);
+        SV4Command v4Cmd;
+        v4Cmd.type = SV4Command::eResume;
+        blockingV4BackendCommand(v4Cmd);
+        DEBUG_LOG << "XXX --> V4 Event: auto handled event: " << dumpVariant(v4Event.toVariant(), 2) << " with here generated answer: Resume";
     }
     else
     {
-        DEBUG_LOG << "XXX --> V4 Event: NOT auto handled unknown event: " << dumpVariant(v4Resp, 2);
+        DEBUG_LOG << "XXX --> V4 Event: NOT auto handled unknown event: " << dumpVariant(v4Event.toVariant(), 2);
         return false;
     }
 
@@ -408,9 +586,8 @@ void CdpDebuggerFrontend::sendInitialEvents(QWebSocket* client)
 void CdpDebuggerFrontend::createAndSentScriptParsedEvents(QWebSocket* client)
 {
     // fetch scripts via existing mapper function
-    QVariantMap v4Req = V4CdpMapper::v4Request_scripts(V4CdpMapper::V4OnlyCommands::GetScripts, 0);
-    QVariant v4Resp = blockingV4BackendCall(v4Req);
-    QVariantList scripts = v4Resp.toMap().value("Result").toMap().value("result").toList();
+    SV4Result v4Result = blockingV4BackendCommand(V4CdpMapper::v4Request_scripts(V4CdpMapper::V4OnlyCommands::GetScripts));
+    QVariantList scripts = v4Result.result.toList();
 
     int contextId = 1; // seems ok
 
@@ -430,25 +607,136 @@ QVariant CdpDebuggerFrontend::blockingV4BackendCall(QVariantMap& request) {
     return response;
 }
 
+SV4Result CdpDebuggerFrontend::blockingV4BackendCommand(const SV4Command& command) {
+    DEBUG_LOG << "<-- Blocking command for backend:" << SV4Command::typeName(command.type);
+    if (m_typedBackend)
+        return m_commandCall(0, command);
+
+    // Add a dummy ID for this direct call
+    QVariantMap request{{"ID", 0}, {"Command", command.toVariant()}};
+    QVariant response = m_getHandledByBackend(request);
+    DEBUG_LOG << "--> Wrapping response for backend call:" << variantMapToJsonString(response.toMap(), true);
+    return SV4Result::fromVariant(response.toMap().value("Result").toMap());
+}
+
 void CdpDebuggerFrontend::sendToClient(QWebSocket* client, const QJsonDocument& doc)
 {
     if (client && client->state() == QAbstractSocket::ConnectedState) {
-        QString message = doc.toJson(QJsonDocument::Compact);
-        client->sendTextMessage(message);
+        QByteArray json = doc.toJson(QJsonDocument::Compact);
+        QString message = QString::fromUtf8(json);
+        enqueueForClient(client, message, json.size(), false);
         DEBUG_LOG << "XXX <-- CDP Sent to client:" << message;
     } else {
         qWarning() << "Cannot send to client - not connected";
     }
 }
 
+void CdpDebuggerFrontend::broadcastToClients(const QVariantMap& message)
+{
+    // encoded once, every queue shares the same string data
+    QByteArray json = QJsonDocument::fromVariant(message).toJson(QJsonDocument::Compact);
+    QString text = QString::fromUtf8(json);
+    bool droppable = isDroppableEvent(message.value("method").toString());
+    DEBUG_LOG << "XXX <-- CDP Broadcast to clients:" << text;
+
+    for (QPointer<QWebSocket> &client : m_responseClients) {
+        if (!client || client->state() != QAbstractSocket::ConnectedState) {
+            DEBUG_LOG << "XXX invalid client entry";
+            continue;
+        }
+        enqueueForClient(client, text, json.size(), droppable);
+    }
+}
+
+void CdpDebuggerFrontend::enqueueForClient(QWebSocket* client, const QString& message, qint64 bytes, bool droppable)
+{
+    auto it = m_outbound.find(client);
+    if (it == m_outbound.end())
+        return;
+    SOutboundQueue& queue = it.value();
+
+    queue.messages.append(SOutboundMessage{message, bytes, droppable});
+    queue.queuedBytes += bytes;
+
+    if (m_maxQueuedBytes > 0 && queue.queuedBytes > m_maxQueuedBytes && m_backpressurePolicy == DropEvents) {
+        int dropped = 0;
+        for (auto msg = queue.messages.begin(); msg != queue.messages.end() && queue.queuedBytes > m_maxQueuedBytes; ) {
+            if (!msg->droppable) {
+                ++msg;
+                continue;
+            }
+            queue.queuedBytes -= msg->bytes;
+            msg = queue.messages.erase(msg);
+            dropped++;
+        }
+        qWarning() << "CDP client does not keep up, dropped" << dropped << "events";
+    }
+
+    // responses and state changing events must not be lost, a client still over the limit is let go
+    if (m_maxQueuedBytes > 0 && queue.queuedBytes > m_maxQueuedBytes) {
+        qWarning() << "CDP client does not keep up, disconnecting it";
+        m_outbound.erase(it);
+        // not from here, the broadcast may still be iterating the clients, onCdpDisconnected does the rest
+        QMetaObject::invokeMethod(client, [client]() { client->abort(); }, Qt::QueuedConnection);
+        return;
+    }
+
+    scheduleFlush();
+}
+
+void CdpDebuggerFrontend::scheduleFlush()
+{
+    // everything queued in one event loop pass is written together
+    if (m_flushScheduled)
+        return;
+    m_flushScheduled = true;
+    QMetaObject::invokeMethod(this, "flushClients", Qt::QueuedConnection);
+}
+
+void CdpDebuggerFrontend::flushClients()
+{
+    m_flushScheduled = false;
+
+    // a failing socket may disconnect while sending, so iterate over a copy of the keys
+    const QList<QWebSocket*> clients = m_outbound.keys();
+    for (QWebSocket* client : clients) {
+        auto it = m_outbound.find(client);
+        if (it == m_outbound.end())
+            continue;
+        SOutboundQueue& queue = it.value();
+        if (queue.messages.isEmpty() || client->state() != QAbstractSocket::ConnectedState)
+            continue;
+
+        // the remaining messages are sent once bytesWritten reports progress
+        bool sent = false;
+        while (!queue.messages.isEmpty() && queue.inFlight < SOCKET_HIGH_WATER) {
+            SOutboundMessage msg = queue.messages.takeFirst();
+            queue.queuedBytes -= msg.bytes;
+            queue.inFlight += client->sendTextMessage(msg.text);
+            sent = true;
+        }
+        if (sent)
+            client->flush();
+    }
+}
+
 void CdpDebuggerFrontend::onV4EventAvailable(const int noOfPendingEvents)
 {
     DEBUG_LOG << "XXX V4 new event available, pending events:" << noOfPendingEvents;
-    int remainingEvents = noOfPendingEvents;
-    // fetching all events from backend
-    while (remainingEvents-- > 0) {
-        wrapperSendRequestToBackend(QVariantMap {{"Control", "PullEvent"}});
-        // the backend will than send the events and they will than be processed
-        // by the frontend via onBackendResponse()
-    }
+    // the backend notifies once per event, coalesce them into a single drain
+    if (m_drainScheduled)
+        return;
+    m_drainScheduled = true;
+    QMetaObject::invokeMethod(this, "drainV4Events", Qt::QueuedConnection);
+}
+
+void CdpDebuggerFrontend::drainV4Events()
+{
+    m_drainScheduled = false;
+    // the backend will than send the events in one batch and they will than be processed
+    // by the frontend via onBackendEvents() or onBackendResponse()
+    if (m_typedBackend)
+        emit requestEventsFromBackend(MAX_EVENTS_PER_DRAIN);
+    else
+        wrapperSendRequestToBackend(QVariantMap {{"Control", "PullEvents"}, {"Max", MAX_EVENTS_PER_DRAIN}});
 }
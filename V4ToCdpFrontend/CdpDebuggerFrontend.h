@@ -7,11 +7,20 @@
 #include <QVariant>
 #include <QString>
 #include <QPointer>
+#include <QMap>
+#include <QHash>
+#include <QElapsedTimer>
+
+#include <list>
+
+#include "V4DebugProtocol.h"
+#include "V4CdpMapper.h"
 
 // Forward Declarations
 class QHttpServer;
 class QWebSocket;
 class QTcpSocket;
+class QTimer;
 template <typename Value> class QList;
 
 using BackendSyncCall = std::function<QVariant(const QVariant&)>;
@@ -26,16 +35,45 @@ class CdpDebuggerFrontend : public QObject
 
         void startServer(quint16 port = 9222);
 
+        // install the backend's debug agent only while at least one client is connected
+        void setAttachOnDemand(bool onDemand) { m_attachOnDemand = onDemand; }
+
+        // in-process backends exchange typed commands, results and events instead of QVariant maps,
+        // commandCall must block until the command was handled, controls still use getHandledByBackend
+        void setTypedBackend(V4CommandCall commandCall);
+
+        // requests the backend did not answer within timeoutMs are failed, beyond maxPending the oldest ones are
+        void setRequestLimits(int timeoutMs, int maxPending);
+
+        // what to do when a client does not read its messages fast enough
+        enum BackpressurePolicy {
+            DropEvents,     // console events are dropped oldest first, a client still over the limit is disconnected
+            Disconnect      // the client is disconnected
+        };
+        // maxQueuedBytes bounds the messages waiting per client, 0 means unbounded
+        void setBackpressure(qint64 maxQueuedBytes, BackpressurePolicy policy);
+
+        // caps the time a session's evaluation may run before the engine is interrupted, 0 leaves it to the backend,
+        // applies to sessions connecting afterwards, a client may lower its own with "?evaluateBudget=<ms>" in the websocket url
+        void setEvaluateBudget(int msecs) { m_evaluateBudget = msecs; }
+
     signals:
         void sendRequestToBackend(const QVariant& request);
+        void sendCommandToBackend(int id, const SV4Command& command);
+        void requestEventsFromBackend(int max);
 
     public slots:
         void onBackendResponse(const QVariant& response);
         void onV4EventAvailable(const int noOfPendingEvents);
+        void onBackendResult(int id, const SV4Result& result);
+        void onBackendEvents(const QList<SV4Event>& events);
 
     private slots:
+        void drainV4Events();
         void onCdpMessageReceived(const QString& message, QWebSocket* client);
         void onCdpDisconnected(QWebSocket* client);
+        void expirePendingRequests();
+        void flushClients();
 
     private:
         void onNewWebSocketConnection();
@@ -45,15 +83,68 @@ class CdpDebuggerFrontend : public QObject
         QVariantMap mapCdpToV4(const QJsonObject& cdpCmd);
         QJsonObject mapV4ToCdp(const QVariantMap& v4Resp);
         void sendToClient(QWebSocket* client, const QJsonDocument& doc);
+        void broadcastToClients(const QVariantMap& message);
+        void enqueueForClient(QWebSocket* client, const QString& message, qint64 bytes, bool droppable);
+        void scheduleFlush();
         void wrapperSendRequestToBackend(const QVariant& request);
+        void wrapperSendCommandToBackend(int id, const SV4Command& command);
         void createAndSentScriptParsedEvents(QWebSocket *client);
+        void processV4Event(const SV4Event& v4Event);
+
+        int addPendingRequest(QWebSocket* client, int cdpId, V4CdpMapper::CdpMethod method, const QVariantMap& params);
+        void failPendingRequest(int sequence, const QString& message);
 
         QVariant blockingV4BackendCall(QVariantMap& request);
+        SV4Result blockingV4BackendCommand(const SV4Command& command);
 
         BackendSyncCall m_getHandledByBackend;
+        V4CommandCall m_commandCall;
+        bool m_typedBackend = false;
         const QString m_frontendName;
         QHttpServer* m_httpServer;
         QList<QPointer<QWebSocket>> m_responseClients;
+        bool m_attachOnDemand = false;
+        bool m_drainScheduled = false; // one batch drain per event loop pass
+
+        // CDP requests forwarded to the backend, keyed by our own sequence number as the clients' ids may collide
+        struct SPendingRequest
+        {
+            QPointer<QWebSocket> client;
+            int cdpId = -1;
+            V4CdpMapper::CdpMethod method = V4CdpMapper::CdpUnknown;
+            QVariantMap params;
+            qint64 deadline = 0;
+            std::list<int>::iterator age; // position in m_pendingAge
+        };
+        QHash<int, SPendingRequest> m_pendingRequests;
+        std::list<int> m_pendingAge; // sequence numbers, the oldest request comes first, the numbers wrap around
+        int m_lastSequence = 0; // 0 is used by the blocking calls
+        SPendingRequest takePendingRequest(int sequence);
+        int m_requestTimeout;
+        int m_maxPendingRequests;
+        QElapsedTimer m_clock;
+        QTimer* m_expireTimer;
+
+        // messages are handed to a socket only while less than SOCKET_HIGH_WATER bytes are still unwritten,
+        // the rest waits here; a message encoded once for all clients is shared between the queues
+        struct SOutboundMessage
+        {
+            QString text;
+            qint64 bytes = 0; // utf-8 size as written to the socket
+            bool droppable = false;
+        };
+        struct SOutboundQueue
+        {
+            QList<SOutboundMessage> messages;
+            qint64 queuedBytes = 0;
+            qint64 inFlight = 0; // handed to the socket, not yet reported by bytesWritten
+        };
+        QHash<QWebSocket*, SOutboundQueue> m_outbound;
+        qint64 m_maxQueuedBytes;
+        BackpressurePolicy m_backpressurePolicy = DropEvents;
+        bool m_flushScheduled = false;
+        int m_evaluateBudget = 0; // of new sessions
+        QHash<QWebSocket*, int> m_sessionBudgets;
         QVariantMap debuggerGlobals;
-        bool autoReplyForSomeEvents(QVariantMap &v4Resp);
+        bool autoReplyForSomeEvents(const SV4Event &v4Event);
 };
@@ -3,27 +3,21 @@
 #include <QVariant>
 #include <QVariantMap>
 #include <QVariantList>
-#include <QMutexLocker>
 #include <QString>
 #include <QDebug>
 #include <QUrl>
 #include <QRegularExpression>
 
-#include "V4Helpers.h"
+#include <array>
 
 // DEBUG_LOGGING_ENABLED via CMake needs to be enabled to spill out stuff. See debug_out.h for more
 #include "debug_out.h"
 #include "dump_variant.h"
 
-#define MAPPER_METADATA "_mapper_metadata" // will only be set in a module if it can handle the request
-#define INTERNAL_MAPPER "_mapper_internal" // used for no where no direct CDP equal method exists
-
 // helper functions
-static void createNoOpCdpToV4(QVariantMap& v4Request, QVariantMap& cdpRequest) {
-        v4Request["ID"] = cdpRequest.value("id");
-        v4Request["Command"] = QVariantMap{{"type", "NoOp"}};
-        //v4Request["handled"] = true;
-        v4Request[MAPPER_PASSTHROUGH] = true;
+static void createNoOpCdpToV4(SV4MappedRequest& v4Request) {
+        v4Request.command = SV4Command();
+        v4Request.passthrough = true;
 }
 
 static QString normalizeScriptName(const QString &input)
@@ -41,139 +35,560 @@ static QString normalizeScriptName(const QString &input)
        return input.trimmed();
 }
 
-static inline V4CdpMapper::V4OnlyCommands getInternalMethod(const QVariantMap &v4)
+// ---------------------- call frames ----------------------
+//
+// Pause events carry the first frames as full call frames, so a pause costs a single engine job,
+// DevTools can not page call frames, the rest is offered as a stack trace it loads on demand with
+// Debugger.getStackTrace using an id of the form "frames:<pause>:<first frame>"
+//
+
+#define CDP_FRAMES_STACK_ID "frames:"
+#define CDP_FRAMES_PAGE 64
+
+static int cdpLineNumber(int v4LineNumber)
 {
-    return static_cast<V4CdpMapper::V4OnlyCommands>(
-        v4.value(INTERNAL_MAPPER, static_cast<int>(V4CdpMapper::V4OnlyCommands::None)).toInt()
-    );
+    return qMax(0, v4LineNumber - 1); // CDP lines are 0 based
 }
 
-// V4CdpMapper implementation
-// Static members
-QHash<int, QVariantMap> V4CdpMapper::s_origCdpRequests;
-QMutex V4CdpMapper::s_mutex;
+static QVariantMap cdpObjectRef(quint64 handle)
+{
+    return QVariantMap{{"type", "object"}, {"className", "Object"}, {"objectId", QString::number(handle)}};
+}
 
-QVariantMap V4CdpMapper::mapCdpToV4Request(QVariantMap &cdpRequest)
+static QVariantList cdpScopeChain(const SV4CallFrame &frame)
 {
-    // Try module mappers in an order that makes sense; the first non-empty
-    // result is considered the mapping for this CDP request.
-    QVariantMap v4;
+    QVariantList scopeChain;
+    bool local = true;
+    for (const SV4CallFrame::SScope &scope : frame.scopeChain) {
+        QString type;
+        if (scope.type == "CallContext") {
+            type = local ? "local" : "closure";
+            local = false;
+        }
+        else if (scope.type == "BlockContext")  type = "block";
+        else if (scope.type == "WithContext")   type = "with";
+        else if (scope.type == "GlobalContext") type = "global";
+        else                                    type = "script";
+        scopeChain.append(QVariantMap{{"type", type}, {"object", cdpObjectRef(scope.object)}});
+    }
+    return scopeChain;
+}
+
+// Debugger.CallFrame of a paused event
+static QVariantList cdpCallFrames(const QVector<SV4CallFrame> &frames)
+{
+    QVariantList callFrames;
+    for (const SV4CallFrame &frame : frames) {
+        QVariantMap cf;
+        cf["callFrameId"] = QString::number(frame.index);
+        cf["functionName"] = frame.functionName;
+        cf["location"] = QVariantMap{
+            {"scriptId", QString::number(frame.scriptId)},
+            {"lineNumber", cdpLineNumber(frame.lineNumber)},
+            {"columnNumber", frame.columnNumber}
+        };
+        cf["url"] = frame.fileName;
+        cf["scopeChain"] = cdpScopeChain(frame);
+        cf["this"] = cdpObjectRef(frame.thisObject);
+        cf["canBeRestarted"] = false;
+        callFrames.append(cf);
+    }
+    return callFrames;
+}
+
+// Runtime.CallFrame of a stack trace
+static QVariantList cdpStackTraceFrames(const QVector<SV4CallFrame> &frames)
+{
+    QVariantList callFrames;
+    for (const SV4CallFrame &frame : frames) {
+        callFrames.append(QVariantMap{
+            {"functionName", frame.functionName},
+            {"scriptId", QString::number(frame.scriptId)},
+            {"url", frame.fileName},
+            {"lineNumber", cdpLineNumber(frame.lineNumber)},
+            {"columnNumber", frame.columnNumber}
+        });
+    }
+    return callFrames;
+}
+
+static QVariantMap cdpPausedParams(const QString &reason, const SV4Event &v4Event)
+{
+    QVariantMap p;
+    p["reason"] = reason;
+    p["callFrames"] = cdpCallFrames(v4Event.callFrames);
+    if (v4Event.frameCount > v4Event.callFrames.size()) // loaded only when the client expands the stack
+        p["asyncStackTraceId"] = QVariantMap{{"id", QString(CDP_FRAMES_STACK_ID "%1:%2").arg(v4Event.pauseId).arg(v4Event.callFrames.size())}};
+    return p;
+}
+
+// ---------------------- CDP method table ----------------------
+//
+// CDP -> V4: the command type comes from the table, the request builder only fills in the attributes
+// V4 -> CDP: the response builder sets "result" or "error", without one the V4 result is passed through
+//
+
+using CdpRequestFn = void (*)(const QVariantMap &params, SV4Command &v4Command);
+using CdpResponseFn = void (*)(const SV4Result &v4Result, const QVariantMap &params, QVariantMap &cdpResponse);
+
+// Debugger.*
+static void cdpRequest_setBreakpointByUrl(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.breakpointData = QVariantMap{
+        {"fileName", normalizeScriptName(params.value("url").toString())},
+        {"lineNumber", params.value("lineNumber")},
+        {"condition", params.value("condition")},
+        {"enabled", true} // we assume breakpoints are always enabled when set
+    };
+}
+
+static void cdpResponse_setBreakpointByUrl(const SV4Result &v4Result, const QVariantMap &params, QVariantMap &cdpResponse)
+{
+    bool isValidId;
+    int breakpointId = v4Result.result.toInt(&isValidId);
+
+    if (isValidId) {
+        cdpResponse["result"] = QVariantMap{{"breakpointId", QString::number(breakpointId)}};
+    } else {
+        // Failed to set breakpoint
+        cdpResponse["error"] = QVariantMap{
+            {"code", -32000},
+            {"message", QString("No script matching %1").arg(params.value("url").toString())}
+        };
+    }
+}
 
-    auto tryMap = [&](auto mapper) -> bool {
-        v4 = mapper(cdpRequest);
-        if (cdpRequest.contains(MAPPER_METADATA)) {
-            storeOrigCdpRequest(cdpRequest.value("id").toInt(), cdpRequest);
-            return true;
+static void cdpRequest_removeBreakpoint(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.breakpointId = params.value("breakpointId").toInt();
+}
+
+static void cdpResponse_getPossibleBreakpoints(const SV4Result &v4Result, const QVariantMap &, QVariantMap &cdpResponse)
+{
+    // V4 Result is likely a list of breakpoints
+    QVariantList outList;
+    for (const QVariant &b : v4Result.result.toList()) {
+        QVariantMap bm = b.toMap();
+        QVariantMap e;
+        e["lineNumber"] = bm.value("lineNumber");
+        e["scriptId"] = bm.value("scriptId");
+        outList.append(e);
+    }
+    cdpResponse["result"] = QVariantMap{{"locations", outList}};
+}
+
+static void cdpRequest_getScriptSource(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.scriptId = params.value("scriptId").toLongLong();
+}
+
+static void cdpResponse_getScriptSource(const SV4Result &v4Result, const QVariantMap &, QVariantMap &cdpResponse)
+{
+    cdpResponse["result"] = QVariantMap{{"scriptSource", v4Result.result.toMap().value("contents")}};
+}
+
+static void cdpRequest_getStackTrace(const QVariantMap &params, SV4Command &v4Command)
+{
+    QString stackTraceId = params.value("stackTraceId").toMap().value("id").toString();
+    if (stackTraceId.startsWith(CDP_FRAMES_STACK_ID)) {
+        QStringList parts = stackTraceId.mid(int(sizeof(CDP_FRAMES_STACK_ID)) - 1).split(':');
+        v4Command.type = SV4Command::eGetCallFrames;
+        v4Command.pauseId = parts.value(0).toInt();
+        v4Command.contextIndex = parts.value(1).toInt();
+        v4Command.count = CDP_FRAMES_PAGE;
+    }
+}
+
+static void cdpResponse_getStackTrace(const SV4Result &v4Result, const QVariantMap &params, QVariantMap &cdpResponse)
+{
+    if (v4Result.type == "V4CallFrames") { // a page of the paused stack
+        QVariantMap page = v4Result.result.toMap();
+        QVector<SV4CallFrame> frames;
+        for (const QVariant &frame : page.value("callFrames").toList())
+            frames.append(SV4CallFrame::fromVariant(frame.toMap()));
+
+        QString pause = params.value("stackTraceId").toMap().value("id").toString().section(':', 1, 1);
+        QVariantMap stackTrace{{"description", "more frames"}, {"callFrames", cdpStackTraceFrames(frames)}};
+        int next = frames.isEmpty() ? 0 : frames.last().index + 1;
+        if (!frames.isEmpty() && next < page.value("frameCount").toInt())
+            stackTrace["parentId"] = QVariantMap{{"id", QString(CDP_FRAMES_STACK_ID "%1:%2").arg(pause).arg(next)}};
+        cdpResponse["result"] = QVariantMap{{"stackTrace", stackTrace}};
+        return;
+    }
+
+    // Convert string frames or V4 frames to CDP callFrames[] structure
+    QVariantList callFrames;
+    for (const QVariant &f : v4Result.result.toList()) {
+        // If v4 provided plain strings like "func() at a.js:10", parse minimally
+        if (f.typeId() == QMetaType::QString) {
+            QString s = f.toString();
+            // naive parse
+            QString func = "";
+            QString file = "";
+            int line = 0;
+            int at = s.indexOf(" at ");
+            if (at == -1)
+                continue; // not a frame
+            func = s.left(at);
+            QString rest = s.mid(at + 4);
+            int colon = rest.lastIndexOf(":");
+            if (colon != -1) {
+                file = rest.left(colon);
+                line = rest.mid(colon + 1).toInt();
+            } else {
+                file = rest;
+            }
+            QVariantMap cf;
+            cf["functionName"] = func;
+            cf["url"] = file;
+            cf["lineNumber"] = line;
+            callFrames.append(cf);
+        } else if (f.canConvert<QVariantMap>()) {
+            QVariantMap fm = f.toMap();
+            QVariantMap cf;
+            cf["functionName"] = fm.value("functionName");
+            cf["url"] = fm.value("fileName");
+            cf["lineNumber"] = fm.value("lineNumber");
+            callFrames.append(cf);
         }
+    }
+    cdpResponse["result"] = QVariantMap{{"callFrames", callFrames}};
+}
+
+// evaluations which timed out or were refused are reported like an exception thrown by the expression
+static bool cdpEvaluateError(const SV4Result &v4Result, QVariantMap &cdpResponse)
+{
+    QString className, text;
+    if (v4Result.error == "EvaluateTimeout") {
+        className = "Error";
+        text = "Error: Execution was terminated, the evaluation timed out";
+    } else if (v4Result.error == "SideEffect") {
+        className = "EvalError";
+        text = "EvalError: Possible side-effect in debug-evaluate";
+    } else
         return false;
+
+    cdpResponse["result"] = QVariantMap{
+        {"result", QVariantMap{{"type", "object"}, {"subtype", "error"}, {"className", className}, {"description", text}}},
+        {"exceptionDetails", QVariantMap{{"exceptionId", 1}, {"text", text}, {"lineNumber", 0}, {"columnNumber", 0}}}
     };
+    return true;
+}
 
-    // Versuche alle Mapper der Reihe nach
-    if (tryMap(mapCdpToV4Request_debugger) ||        // Debugger (Debugger.* commands)
-            tryMap(mapCdpToV4Request_runtime))       // Runtime (Runtime.* commands)
-    {
-        return v4;
+static void cdpRequest_evaluateOnCallFrame(const QVariantMap &params, SV4Command &v4Command)
+{
+    QString expr = params.value("expression").toString();
+    v4Command.contextIndex = params.value("callFrameId").toInt(); // the frame index, see cdpCallFrames
+    if (expr == "this") {
+        v4Command.type = SV4Command::eGetThisObject;
+    } else {
+        // general evaluation -> Evaluate
+        v4Command.program = expr;
+        v4Command.timeout = params.value("timeout").toInt();
+        v4Command.throwOnSideEffect = params.value("throwOnSideEffect").toBool();
     }
 
-    // No mapping found — return empty (dispatcher / caller should handle fallback)
-    return QVariantMap();
+    // refs created by the evaluation are released with this group
+    v4Command.objectGroup = params.value("objectGroup").toString();
 }
 
-QVariantMap V4CdpMapper::mapV4ToCdpResponse(const QVariantMap &v4Response)
+static void cdpResponse_evaluateOnCallFrame(const SV4Result &v4Result, const QVariantMap &, QVariantMap &cdpResponse)
 {
-    static const QHash<QString, MapperFn> mappers = {
-        {V4CdpMapper::Modules::Debugger,     mapV4ToCdpResponse_debugger},
-        {V4CdpMapper::Modules::Runtime,      mapV4ToCdpResponse_runtime}
-    };
+    if (cdpEvaluateError(v4Result, cdpResponse))
+        return;
+
+    QVariantMap res = v4Result.result.toMap();
+    // Expecting object handle
+    QVariantMap out;
+    if (res.value("type").toString() == "ObjectValue") {
+        out["result"] = QVariantMap{{"type", "object"}, {"objectId", res.value("value")}};
+    } else {
+        out["result"] = v4Result.toVariant();
+    }
+    cdpResponse["result"] = out;
+}
+
+// Runtime.*
+static void cdpRequest_evaluate(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.program = params.value("expression").toString();
+    v4Command.timeout = params.value("timeout").toInt();
+    v4Command.throwOnSideEffect = params.value("throwOnSideEffect").toBool();
+
+    // refs created by the evaluation are released with this group
+    v4Command.objectGroup = params.value("objectGroup").toString();
+}
+
+static void cdpResponse_evaluate(const SV4Result &v4Result, const QVariantMap &, QVariantMap &cdpResponse)
+{
+    if (cdpEvaluateError(v4Result, cdpResponse))
+        return;
 
-    // We expect v4Response to contain "ID" (as the backend sets it).
-    int id = v4Response.value("ID").toInt(); // TODO we may need to set a default value like -1
-    if (id < 0) {
-        qWarning() << "V4CdpMapper::mapV4ToCdpResponse: V4 response missing ID" << v4Response;
-        return QVariantMap();
+    cdpResponse["result"] = QVariantMap{{"result", QVariantMap{
+        {"type", "string"},
+        {"value", v4Result.toVariant()}
+    }}};
+}
+
+// ---------------------- properties ----------------------
+//
+// Long arrays are answered with buckets like "[0 … 99]", each one is an object
+// whose properties are the indices it spans or smaller buckets
+//
+
+static void cdpRequest_getProperties(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.objectId = params.value("objectId").toString().toULongLong();
+    v4Command.filter = SV4Command::eAllProperties;
+    v4Command.offset = 0;
+    v4Command.count = params.value("accessorPropertiesOnly").toBool() ? 0 : -1; // accessors are not reported
+    v4Command.cdpValues = true; // the backend encodes the property descriptors
+}
+
+static void cdpResponse_getProperties(const SV4Result &v4Result, const QVariantMap &, QVariantMap &cdpResponse)
+{
+    cdpResponse["result"] = QVariantMap{{"result", v4Result.result.toMap().value("properties")}};
+}
+
+static void cdpRequest_callFunctionOn(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.objectId = params.value("functionDeclaration").toULongLong(); // TODO not implemented in backend
+}
+
+static void cdpRequest_releaseObject(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.objectId = params.value("objectId").toULongLong();
+}
+
+static void cdpRequest_releaseObjectGroup(const QVariantMap &params, SV4Command &v4Command)
+{
+    v4Command.objectGroup = params.value("objectGroup").toString();
+}
+
+static void cdpResponse_empty(const SV4Result &, const QVariantMap &, QVariantMap &cdpResponse)
+{
+    cdpResponse["result"] = QVariantMap(); // empty result
+}
+
+struct SCdpMethodEntry
+{
+    const char* name;
+    V4CdpMapper::CdpMethod method;
+    quint32 flags;
+    SV4Command::EType v4Type;
+    CdpRequestFn request;
+    CdpResponseFn response;
+};
+
+#define CDP_IMMEDIATE   V4CdpMapper::CdpImmediate
+#define CDP_NOOP        V4CdpMapper::CdpNoOp
+
+// the order must match V4CdpMapper::CdpMethod
+static constexpr SCdpMethodEntry s_cdpMethods[] = {
+    // answered by the frontend, the agent is attached and detached with the connections
+    {"Runtime.enable",                  V4CdpMapper::RuntimeEnable,                     CDP_IMMEDIATE,  SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Debugger.enable",                 V4CdpMapper::DebuggerEnable,                    CDP_IMMEDIATE,  SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Debugger.disable",                V4CdpMapper::DebuggerDisable,                   CDP_IMMEDIATE,  SV4Command::eUnknown,           nullptr,                            nullptr},
+
+    // runtime debugger controls
+    {"Debugger.pause",                  V4CdpMapper::DebuggerPause,                     0,              SV4Command::eInterrupt,         nullptr,                            nullptr},
+    {"Debugger.resume",                 V4CdpMapper::DebuggerResume,                    0,              SV4Command::eContinue,          nullptr,                            nullptr},
+    {"Debugger.stepInto",               V4CdpMapper::DebuggerStepInto,                  0,              SV4Command::eStepInto,          nullptr,                            nullptr},
+    {"Debugger.stepOver",               V4CdpMapper::DebuggerStepOver,                  0,              SV4Command::eStepOver,          nullptr,                            nullptr},
+    {"Debugger.stepOut",                V4CdpMapper::DebuggerStepOut,                   0,              SV4Command::eStepOut,           nullptr,                            nullptr},
+
+    // Breakpoints
+    {"Debugger.setBreakpointByUrl",     V4CdpMapper::DebuggerSetBreakpointByUrl,        0,              SV4Command::eSetBreakpoint,     cdpRequest_setBreakpointByUrl,      cdpResponse_setBreakpointByUrl},
+    {"Debugger.removeBreakpoint",       V4CdpMapper::DebuggerRemoveBreakpoint,          0,              SV4Command::eDeleteBreakpoint,  cdpRequest_removeBreakpoint,        cdpResponse_empty},
+    {"Debugger.getPossibleBreakpoints", V4CdpMapper::DebuggerGetPossibleBreakpoints,    0,              SV4Command::eGetBreakpoints,    nullptr,                            cdpResponse_getPossibleBreakpoints},
+
+    // Script / Source, Stack
+    {"Debugger.getScriptSource",        V4CdpMapper::DebuggerGetScriptSource,           0,              SV4Command::eGetScriptData,     cdpRequest_getScriptSource,         cdpResponse_getScriptSource},
+    {"Debugger.getStackTrace",          V4CdpMapper::DebuggerGetStackTrace,             0,              SV4Command::eGetBacktrace,      cdpRequest_getStackTrace,           cdpResponse_getStackTrace},
+
+    // Debugger Setup / Configuration -- no real backend mapping needed as they are not supported by V4
+    {"Debugger.setPauseOnExceptions",   V4CdpMapper::DebuggerSetPauseOnExceptions,      CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Debugger.setAsyncCallStackDepth", V4CdpMapper::DebuggerSetAsyncCallStackDepth,    CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Debugger.setBlackboxPatterns",    V4CdpMapper::DebuggerSetBlackboxPatterns,       CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+
+    {"Debugger.evaluateOnCallFrame",    V4CdpMapper::DebuggerEvaluateOnCallFrame,       0,              SV4Command::eEvaluate,          cdpRequest_evaluateOnCallFrame,     cdpResponse_evaluateOnCallFrame},
+
+    // Runtime
+    {"Runtime.evaluate",                V4CdpMapper::RuntimeEvaluate,                   0,              SV4Command::eEvaluate,          cdpRequest_evaluate,                cdpResponse_evaluate},
+    {"Runtime.getProperties",           V4CdpMapper::RuntimeGetProperties,              0,              SV4Command::eGetPropertyRange,  cdpRequest_getProperties,           cdpResponse_getProperties},
+    {"Runtime.callFunctionOn",          V4CdpMapper::RuntimeCallFunctionOn,             0,              SV4Command::eScriptValueToString, cdpRequest_callFunctionOn,        nullptr},
+    {"Runtime.releaseObject",           V4CdpMapper::RuntimeReleaseObject,              0,              SV4Command::eReleaseObject,     cdpRequest_releaseObject,           cdpResponse_empty},
+    {"Runtime.releaseObjectGroup",      V4CdpMapper::RuntimeReleaseObjectGroup,         0,              SV4Command::eReleaseObjectGroup, cdpRequest_releaseObjectGroup,     cdpResponse_empty},
+
+    // no real backend mapping needed as they are not supported by V4
+    {"Runtime.addBinding",              V4CdpMapper::RuntimeAddBinding,                 CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Runtime.removeBinding",           V4CdpMapper::RuntimeRemoveBinding,              CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Runtime.getHeapUsage",            V4CdpMapper::RuntimeGetHeapUsage,               CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+    {"Runtime.awaitPromise",            V4CdpMapper::RuntimeAwaitPromise,               CDP_NOOP,       SV4Command::eUnknown,           nullptr,                            nullptr},
+};
+
+#undef CDP_IMMEDIATE
+#undef CDP_NOOP
+
+constexpr int s_cdpMethodCount = sizeof(s_cdpMethods) / sizeof(s_cdpMethods[0]);
+
+constexpr bool cdpMethodsInOrder()
+{
+    for (int i = 0; i < s_cdpMethodCount; i++) {
+        if (s_cdpMethods[i].method != i)
+            return false;
     }
+    return s_cdpMethodCount == V4CdpMapper::CdpMethodCount;
+}
+static_assert(cdpMethodsInOrder(), "s_cdpMethods must list every CdpMethod in enum order");
 
-    QVariantMap orig = takeOrigCdpRequest(id);
-    if (orig.isEmpty()) {
-        // We don't have the original CDP request — fallback: try modules by v4Response.type or return empty
-        qWarning() << "V4CdpMapper::mapV4ToCdpResponse: original CDP request not found for ID" << id;
-        // Default fallback: wrap result into a generic CDP response
-        QVariantMap cdp;
-        cdp["id"] = id;
-        if (v4Response.contains("Result"))
-            cdp["result"] = v4Response.value("Result");
-        else if (v4Response.contains("Response"))
-            cdp["result"] = v4Response.value("Response");
-        else
-            cdp["result"] = QVariantMap();
-        return cdp;
+//
+// Perfect hash: FNV-1a with a seed searched at compile time, such that every method name lands
+// in its own slot. A lookup is one hash, one slot read and one string compare to reject unknown names.
+//
+
+#define CDP_HASH_SLOTS 128 // power of two, about 4x the method count keeps the seed search short
+
+constexpr quint32 cdpMethodHash(const char* name, quint32 seed)
+{
+    quint32 hash = 2166136261u ^ seed;
+    for (; *name; ++name) {
+        hash ^= (quint8)*name;
+        hash *= 16777619u;
     }
+    return hash;
+}
 
-    // If a reponse could be handled it has MAPPER_METADATA set in its original CDP request
-    const QString type = orig.value(MAPPER_METADATA).toString();
-    if (mappers.contains(type)) {
-        return mappers.value(type)(v4Response, orig);
+static quint32 cdpMethodHash(const QString& name, quint32 seed)
+{
+    quint32 hash = 2166136261u ^ seed;
+    for (QChar c : name) {
+        hash ^= c.unicode(); // method names are ASCII, anything else can not match anyway
+        hash *= 16777619u;
     }
+    return hash;
+}
 
-    // Nothing matched — return generic wrapper
-    qWarning() << "V4CdpMapper::mapV4ToCdpResponse: no module matched for response ID" << id;
-    QVariantMap cdp;
-    cdp["id"] = id;
-    cdp["result"] = v4Response.value("Result");
-    return cdp;
+constexpr bool cdpSeedIsPerfect(quint32 seed)
+{
+    bool used[CDP_HASH_SLOTS] = {};
+    for (const SCdpMethodEntry& entry : s_cdpMethods) {
+        quint32 slot = cdpMethodHash(entry.name, seed) & (CDP_HASH_SLOTS - 1);
+        if (used[slot])
+            return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr quint32 cdpFindSeed()
+{
+    for (quint32 seed = 0; seed < 4096; seed++) {
+        if (cdpSeedIsPerfect(seed))
+            return seed;
+    }
+    return ~0u;
+}
+
+constexpr quint32 s_cdpSeed = cdpFindSeed();
+static_assert(s_cdpSeed != ~0u, "no collision free seed, increase CDP_HASH_SLOTS");
+
+constexpr std::array<quint8, CDP_HASH_SLOTS> cdpBuildSlots()
+{
+    std::array<quint8, CDP_HASH_SLOTS> slots{};
+    for (quint8& slot : slots)
+        slot = V4CdpMapper::CdpUnknown;
+    for (int i = 0; i < s_cdpMethodCount; i++)
+        slots[cdpMethodHash(s_cdpMethods[i].name, s_cdpSeed) & (CDP_HASH_SLOTS - 1)] = (quint8)i;
+    return slots;
+}
+
+static constexpr std::array<quint8, CDP_HASH_SLOTS> s_cdpSlots = cdpBuildSlots();
+
+// V4CdpMapper implementation
+V4CdpMapper::CdpMethod V4CdpMapper::findMethod(const QString &name)
+{
+    quint8 index = s_cdpSlots[cdpMethodHash(name, s_cdpSeed) & (CDP_HASH_SLOTS - 1)];
+    if (index == CdpUnknown || name != QLatin1String(s_cdpMethods[index].name))
+        return CdpUnknown;
+    return (CdpMethod)index;
 }
 
-// ---------------------- Request store helpers ----------------------
-void V4CdpMapper::storeOrigCdpRequest(int id, const QVariantMap &cdpRequest)
+quint32 V4CdpMapper::methodFlags(CdpMethod method)
 {
-    QMutexLocker locker(&s_mutex);
-    s_origCdpRequests.insert(id, cdpRequest);
+    return method < CdpMethodCount ? s_cdpMethods[method].flags : 0;
 }
 
-QVariantMap V4CdpMapper::takeOrigCdpRequest(int id)
+bool V4CdpMapper::mapCdpToV4Request(CdpMethod method, const QVariantMap &params, SV4MappedRequest &v4Request)
 {
-    QMutexLocker locker(&s_mutex);
-    if (!s_origCdpRequests.contains(id))
-        return QVariantMap();
-    QVariantMap r = s_origCdpRequests.take(id);
-    return r;
+    if (method >= CdpMethodCount)
+        return false; // No mapping found — dispatcher / caller should handle fallback
+
+    const SCdpMethodEntry &entry = s_cdpMethods[method];
+    if (entry.flags & CdpImmediate)
+        return false; // the frontend answers these on its own
+
+    if (entry.flags & CdpNoOp) {
+        createNoOpCdpToV4(v4Request);
+    } else {
+        v4Request.command.type = entry.v4Type;
+        if (entry.request)
+            entry.request(params, v4Request.command);
+    }
+    return true;
+}
+
+QVariantMap V4CdpMapper::mapV4ToCdpResponse(int cdpId, CdpMethod method, const QVariantMap &params, const SV4Result &v4Result)
+{
+    QVariantMap cdp;
+    cdp["id"] = cdpId;
+
+    if (method >= CdpMethodCount) {
+        // We don't know the original CDP request
+        qWarning() << "V4CdpMapper::mapV4ToCdpResponse: no CDP method for response ID" << cdpId;
+        // Default fallback: wrap result into a generic CDP response
+        cdp["result"] = v4Result.toVariant();
+        return cdp;
+    }
+
+    const SCdpMethodEntry &entry = s_cdpMethods[method];
+    if (entry.flags & CdpNoOp)
+        cdp["result"] = QVariantMap{}; // No-Op passthrough
+    else if (v4Result.error == "EngineBusy") // the running engine did not reach a safepoint in time
+        cdp["error"] = QVariantMap{{"code", -32000}, {"message", QString("Engine is busy, try again later")}};
+    else if (entry.response)
+        entry.response(v4Result, params, cdp);
+    else
+        cdp["result"] = v4Result.toVariant(); // Default passthrough
+    return cdp;
 }
 
 // ---------------------- domain helpers  ----------------------
-QVariantMap V4CdpMapper::v4Request_location(V4OnlyCommands method, int id, QString fileName, int lineNumber, int scriptId) // fileName only RunToLocation, scriptId only RunToLocationById
+SV4Command V4CdpMapper::v4Request_location(V4OnlyCommands method, QString fileName, int lineNumber, int scriptId) // fileName only RunToLocation, scriptId only RunToLocationById
 {
-    QVariantMap v4;
-    v4["ID"] = id;
-    QVariantMap attrs;
+    SV4Command v4;
 
     if (method == V4OnlyCommands::RunToLocation) {
-        attrs["fileName"] = fileName;
-        attrs["lineNumber"] = lineNumber;
-        v4["Command"] = QVariantMap{{"type", "RunToLocation"}, {"attributes", attrs}};
+        v4.type = SV4Command::eRunToLocation;
+        v4.fileName = fileName;
+        v4.lineNumber = lineNumber;
     } else if (method == V4OnlyCommands::RunToLocationById) {
-        attrs["scriptId"] = scriptId;
-        attrs["lineNumber"] = lineNumber;
-        v4["Command"] = QVariantMap{{"type", "RunToLocationById"}, {"attributes", attrs}};
-    } else {
-        // Not handled by this module
-        v4.clear();
+        v4.type = SV4Command::eRunToLocationByID;
+        v4.scriptId = scriptId;
+        v4.lineNumber = lineNumber;
     }
+    // else: Not handled by this module, type stays eUnknown
     return v4;
 }
 
-QVariantMap V4CdpMapper::v4ToCdpResponse_location(const QVariantMap &v4Response, const QVariantMap &origV4Request)
+QVariantMap V4CdpMapper::v4ToCdpResponse_location(int id, const SV4Result &v4Result, V4OnlyCommands method)
 {
     QVariantMap cdp;
-    int id = v4Response.value("ID").toInt();
-    V4OnlyCommands method = getInternalMethod(origV4Request);
     cdp["id"] = id;
 
-    if (method == V4OnlyCommands::RunToLocation || method == V4OnlyCommands::RunToLocation) {
+    if (method == V4OnlyCommands::RunToLocation || method == V4OnlyCommands::RunToLocationById) {
         // Most control commands return success/empty result
-        if (v4Response.contains("Result"))
-            cdp["result"] = v4Response.value("Result");
-        else
-            cdp["result"] = QVariantMap();
+        cdp["result"] = v4Result.toVariant();
     } else {
         // Not handled by this module
         cdp.clear();
@@ -182,73 +597,25 @@ QVariantMap V4CdpMapper::v4ToCdpResponse_location(const QVariantMap &v4Response,
     return cdp;
 }
 
-// Evaluate
-QVariantMap V4CdpMapper::mapCdpToV4Request_helper_evaluate(QString &method, QVariantMap &cdpRequest)
-{
-    QVariantMap params = cdpRequest.value("params").toMap();
-    int id = cdpRequest.value("id").toInt();
-
-    if (method != "Runtime.evaluate" && method != "Debugger.evaluateOnCallFrame")
-        return QVariantMap();
-
-    QVariantMap v4;
-    v4["ID"] = id;
-    QVariantMap cmd;
-    cmd["type"] = "Evaluate";
-    QVariantMap attrs;
-
-    if (method == "Runtime.evaluate") {
-        attrs["program"] = params.value("expression");
-    } else { // Debugger.evaluateOnCallFrame
-        QString expr = params.value("expression").toString();
-        if (expr == "this") {
-            attrs["contextIndex"] = params.value("callFrameId").toInt();
-            cmd["type"] = "GetThisObject";
-            v4[INTERNAL_MAPPER] = static_cast<int>(V4OnlyCommands::GetThisObject);
-        } else {
-            // general evaluation -> Evaluate
-            attrs["program"] = expr;
-            attrs["contextIndex"] = params.value("callFrameId").toString();
-        }
-    }
-
-    cmd["attributes"] = attrs;
-    v4["Command"] = cmd;
-    return v4;
-}
-
 // Scripts
-QVariantMap V4CdpMapper::v4Request_scripts(V4OnlyCommands method, int id, int since)
+SV4Command V4CdpMapper::v4Request_scripts(V4OnlyCommands method)
 {
-    QVariantMap v4Request; v4Request["ID"] = id;
-    QVariant &v4CommandRef = v4Request["Command"];
-
-    if (method == V4OnlyCommands::GetScripts) {
-        v4CommandRef = QVariantMap{{"type", "GetScripts"}};
-    } else if (method == ScriptsCheckpoint) {
-        v4CommandRef = QVariantMap{{"type", "ScriptsCheckpoint"}};
-    } else if (method == V4OnlyCommands::GetScriptsDelta) {
-        QVariantMap attrs;
-        attrs["since"] = since;
-        v4CommandRef = QVariantMap{{"type", "GetScriptsDelta"}, {"attributes", attrs}};
-    } else {
-        v4Request.clear();
-        return v4Request;
-    }
-
-    return v4Request;
+    if (method == V4OnlyCommands::GetScripts)
+        return SV4Command(SV4Command::eGetScripts);
+    if (method == V4OnlyCommands::ScriptsCheckpoint)
+        return SV4Command(SV4Command::eScriptsCheckpoint);
+    if (method == V4OnlyCommands::GetScriptsDelta)
+        return SV4Command(SV4Command::eGetScriptsDelta);
+    return SV4Command();
 }
 
-QVariantMap V4CdpMapper::v4ToCdpResponse_scripts(const QVariantMap &v4Response, const QVariantMap &origV4Request)
+QVariantMap V4CdpMapper::v4ToCdpResponse_scripts(int id, const SV4Result &v4Result, V4OnlyCommands method)
 {
     QVariantMap cdp;
-    int id = v4Response.value("ID").toInt();
     cdp["id"] = id;
 
-    V4OnlyCommands method = getInternalMethod(origV4Request);
-
     if (method == V4OnlyCommands::GetScripts) {
-        QVariantList v4Scripts = v4Response.value("Result").toList();
+        QVariantList v4Scripts = v4Result.result.toList();
         QVariantList outList;
         for (const QVariant &s : v4Scripts) {
             QVariantMap sm = s.toMap();
@@ -261,9 +628,9 @@ QVariantMap V4CdpMapper::v4ToCdpResponse_scripts(const QVariantMap &v4Response,
         }
         cdp["result"] = QVariantMap{{"scripts", outList}};
     } else if (method == V4OnlyCommands::ScriptsCheckpoint) {
-        cdp["result"] = v4Response.value("Result");
+        cdp["result"] = v4Result.result;
     } else if (method == V4OnlyCommands::GetScriptsDelta) {
-        cdp["result"] = v4Response.value("Result");
+        cdp["result"] = v4Result.result;
     } else {
         cdp.clear();
     }
@@ -272,31 +639,26 @@ QVariantMap V4CdpMapper::v4ToCdpResponse_scripts(const QVariantMap &v4Response,
 }
 
 // Stack & Contexts
-QVariantMap V4CdpMapper::v4Request_stack(V4OnlyCommands method, int id, int contextIndex) // contextIndex only for V4OnlyCommands::GetContextInfo used
+SV4Command V4CdpMapper::v4Request_stack(V4OnlyCommands method, int contextIndex) // contextIndex only for V4OnlyCommands::GetContextInfo used
 {
-    QVariantMap v4; v4["ID"] = id;
-    v4[INTERNAL_MAPPER] = static_cast<int>(method);
+    SV4Command v4;
 
     if (method == V4OnlyCommands::GetContextCount) {
-        v4["Command"] = QVariantMap{{"type", "GetContextCount"}};
+        v4.type = SV4Command::eGetContextCount;
     } else if (method == V4OnlyCommands::GetContextInfo) {
-        QVariantMap attrs; attrs["contextIndex"] = contextIndex;
-        v4["Command"] = QVariantMap{{"type", "GetContextInfo"}, {"attributes", attrs}};
-    } else {
-        v4.clear();
-        return v4;
+        v4.type = SV4Command::eGetContextInfo;
+        v4.contextIndex = contextIndex;
     }
 
     return v4;
 }
 
-QVariantMap V4CdpMapper::v4ToCdpResponse_stack(const QVariantMap &v4Response, const QVariantMap &origV4Request)
+QVariantMap V4CdpMapper::v4ToCdpResponse_stack(int id, const SV4Result &v4Result, V4OnlyCommands method)
 {
-    QVariantMap cdp; int id = v4Response.value("ID").toInt(); cdp["id"] = id;
-    V4OnlyCommands method = getInternalMethod(origV4Request);
+    QVariantMap cdp; cdp["id"] = id;
 
     if (method == V4OnlyCommands::GetContextInfo) { // map to CDP Runtime.CallFrame object
-        QVariantMap r = v4Response.value("Result").toMap();
+        QVariantMap r = v4Result.result.toMap();
         QVariantMap frame;
         frame["functionName"] = r.value("functionName");
         frame["url"] = r.value("fileName");
@@ -309,109 +671,54 @@ QVariantMap V4CdpMapper::v4ToCdpResponse_stack(const QVariantMap &v4Response, co
     return cdp;
 }
 
-QVariantMap V4CdpMapper::mapV4ToCdpResponse_helper_stack(const QVariantMap &v4Response, const QVariantMap &origCdpRequest)
-{
-    QVariantMap cdp; int id = v4Response.value("ID").toInt(); cdp["id"] = id;
-    QString method = origCdpRequest.value("method").toString();
-
-    if (method == "Debugger.getStackTrace") {
-        QVariantList frames = v4Response.value("Result").toList();
-        // Convert string frames or V4 frames to CDP callFrames[] structure
-        QVariantList callFrames;
-        for (const QVariant &f : frames) {
-            // If v4 provided plain strings like "func() at a.js:10", parse minimally
-            if (f.typeId() == QMetaType::QString) {
-                QString s = f.toString();
-                // naive parse
-                QString func = "";
-                QString file = "";
-                int line = 0;
-                int at = s.indexOf(" at ");
-                if (at != -1) {
-                    func = s.left(at);
-                    QString rest = s.mid(at + 4);
-                    int colon = rest.lastIndexOf(":");
-                    if (colon != -1) {
-                        file = rest.left(colon);
-                        line = rest.mid(colon + 1).toInt();
-                    } else {
-                        file = rest;
-                    }
-                }
-                QVariantMap cf;
-                cf["functionName"] = func;
-                cf["url"] = file;
-                cf["lineNumber"] = line;
-                callFrames.append(cf);
-            } else if (f.canConvert<QVariantMap>()) {
-                QVariantMap fm = f.toMap();
-                QVariantMap cf;
-                cf["functionName"] = fm.value("functionName");
-                cf["url"] = fm.value("fileName");
-                cf["lineNumber"] = fm.value("lineNumber");
-                callFrames.append(cf);
-            }
-        }
-        cdp["result"] = QVariantMap{{"callFrames", callFrames}};
-    } else {
-        cdp.clear();
-    }
-
-    return cdp;
-}
-
 // Events (backend -> frontend) — map V4 event to CDP event
-QVariantMap V4CdpMapper::mapV4EventToCdp(const QVariantMap &v4Resp, BackendV4SyncCall backendSyncCall)
+QVariantMap V4CdpMapper::mapV4EventToCdp(const SV4Event &v4Event, V4CommandCall backendCall)
 {
-    DEBUG_LOG << "XXX V4CdpMapper::mapV4EventToCdp " << dumpVariant(v4Resp);
+    DEBUG_LOG << "XXX V4CdpMapper::mapV4EventToCdp " << SV4Event::typeName(v4Event.type);
     QVariantMap cdp;
 
-    QVariantMap v4Event = v4Resp.value("Event").toMap();
-    QString type = v4Event.value("type").toString();
-    QVariantMap attrs = v4Event.value("attributes").toMap();
+    SV4Event::EType type = v4Event.type;
 
-    if (type == "Interrupted") {
+    if (type == SV4Event::eInterrupted) {
         cdp["method"] = "Debugger.paused";
-        cdp["params"] = QVariantMap{{"reason", QString("interrupted")}, {"callFrames", QVariantList()}};
-    } else if (type == "Breakpoint") {
+        cdp["params"] = cdpPausedParams("interrupted", v4Event);
+    } else if (type == SV4Event::eBreakpoint) {
         cdp["method"] = "Debugger.paused";
-        QVariantMap p;
-        p["reason"] = "other"; // is breakpoint
+        QVariantMap p = cdpPausedParams("other", v4Event); // is breakpoint
         QStringList hits;
-        hits.append(attrs.value("breakPointId", -1).toString());
+        hits.append(QString::number(v4Event.breakpointId));
         p["hitBreakpoints"] = hits;
-        p["callFrames"] = QVariantList();
         cdp["params"] = p;
-    } else if (type == "SteppingFinished") {
+    } else if (type == SV4Event::eSteppingFinished) {
         cdp["method"] = "Debugger.paused";
-        cdp["params"] = QVariantMap{{"reason", QString("step")}, {"callFrames", QVariantList()}};
-    } else if (type == "LocationReached") {
+        cdp["params"] = cdpPausedParams("step", v4Event);
+    } else if (type == SV4Event::eLocationReached) {
         cdp["method"] = "Debugger.paused";
-        cdp["params"] = QVariantMap{{"reason", QString("location")}, {"callFrames", QVariantList()}};
-    } else if (type == "DebuggerInvocationRequest") {
+        cdp["params"] = cdpPausedParams("location", v4Event);
+    } else if (type == SV4Event::eDebuggerInvocationRequest) {
         cdp["method"] = "Debugger.paused";
-        cdp["params"] = QVariantMap{{"reason", QString("debuggerStatement DebuggerInvocationRequest")}, {"callFrames", QVariantList()}};
-    } else if (type == "Exception") {
+        cdp["params"] = cdpPausedParams("debuggerStatement DebuggerInvocationRequest", v4Event);
+    } else if (type == SV4Event::eException) {
         cdp["method"] = "Runtime.exceptionThrown";
         QVariantMap ed;
-        ed["text"] = attrs.value("message").toString();
-        ed["exception"] = attrs.value("value");
+        ed["text"] = v4Event.message;
+        ed["exception"] = v4Event.value;
         cdp["params"] = QVariantMap{{"exceptionDetails", ed}};
-    } else if (type == "InlineEvalFinished") {
+    } else if (type == SV4Event::eInlineEvalFinished) {
         cdp["method"] = "Debugger.paused";
-        QVariantMap request = QVariantMap{{"method", "Debugger.getStackTrace"}}; // I guess we are completly wrong here as we need callFrames
-        QVariantMap v4StackTraceReq = mapCdpToV4Request_debugger(request);
-        QVariantMap v4StackTraceResp = backendSyncCall(v4StackTraceReq).toMap();
-        DEBUG_LOG << "XXX V4CdpMapper::mapV4EventToCdp: InlineEvalFinished fetching stack trace:" << dumpVariant(v4StackTraceResp);
-        QVariantMap cdpResponse = mapV4ToCdpResponse_helper_stack(v4StackTraceResp, request);
+        // I guess we are completly wrong here as we need callFrames
+        SV4Result v4StackTraceResp = backendCall(0, SV4Command(SV4Command::eGetBacktrace));
+        DEBUG_LOG << "XXX V4CdpMapper::mapV4EventToCdp: InlineEvalFinished fetching stack trace:" << dumpVariant(v4StackTraceResp.result);
+        QVariantMap cdpResponse{{"id", 0}};
+        cdpResponse_getStackTrace(v4StackTraceResp, QVariantMap(), cdpResponse);
         DEBUG_LOG << "XXX v4 converted to cdpResponse stack trace:" << dumpVariant(cdpResponse);
 
         cdp["params"] = QVariantMap{{"reason", QString("debuggerStatement InlineEvalFinished")}, {"callFrames", QVariantList()}};
-    } else if (type == "Trace") {
+    } else if (type == SV4Event::eTrace) {
         cdp["method"] = "Console.messageAdded";
         QVariantMap msg;
-        msg["text"] = attrs.value("message").toString();
-        msg["level"] = attrs.value("level").toString();
+        msg["text"] = v4Event.message;
+        msg["level"] = QString(); // not reported by the backend
         cdp["params"] = QVariantMap{{"message", msg}};
     } else {
         // Unknown event — return empty map as fallback
@@ -421,322 +728,3 @@ QVariantMap V4CdpMapper::mapV4EventToCdp(const QVariantMap &v4Resp, BackendV4Syn
     //cdp["method"] = "Runtime.executionContextDestroyed"; // is a event not mapped. I guess not needed here
     return cdp;
 }
-
-// Other / Generic
-QVariantMap V4CdpMapper::v4Request_custom(V4OnlyCommands method, int id, QString command, QString args)
-{
-    QVariantMap v4; v4["ID"] = id;
-
-    if (method == V4OnlyCommands::Request) {
-        QVariantMap attrs; attrs["command"] = command; attrs["args"] = args;
-        v4["Command"] = QVariantMap{{"type", "Request"}, {"attributes", attrs}};
-    } else {
-        v4.clear();
-        return v4; // return here so no MAPPER_METADATA can be set
-    }
-
-    return v4;
-}
-
-// the response is not CDP compliance nor used at all
-QVariantMap V4CdpMapper::v4ToCdpResponse_custom(const QVariantMap &v4Response, const QVariantMap &origV4Request)
-{
-    QVariantMap cdp; int id = v4Response.value("ID").toInt(); cdp["id"] = id;
-    V4OnlyCommands method = getInternalMethod(origV4Request);
-
-    if (method == V4OnlyCommands::Request) {
-        cdp["result"] = v4Response.value("Result");
-    } else {
-        cdp.clear();
-    }
-
-    return cdp;
-}
-
-//
-// CDP -> V4 (Debugger.*)
-//
-QVariantMap V4CdpMapper::mapCdpToV4Request_debugger(QVariantMap& cdpRequest)
-{
-    QVariantMap v4Request;
-    v4Request["ID"] = cdpRequest.value("id");
-    QVariant &v4CommandRef = v4Request["Command"];
-    QString method = cdpRequest.value("method").toString();
-    QVariantMap params = cdpRequest.value("params").toMap();
-
-    // Fallback (nicht erkannt)
-    //v4Request["handled"] = false;
-
-    // --------------------
-    // Debugger.enable / disable
-    // --------------------
-    if (method == "Debugger.enable") {
-        v4CommandRef = QVariantMap{{"type", "Attach"}};
-    }
-    else if (method == "Debugger.disable") {
-        v4CommandRef = QVariantMap{{"type", "Detach"}};
-    }
-
-    // --------------------
-    // runtime debugger controls
-    // --------------------
-    else if (method == "Debugger.pause") {
-        v4CommandRef = QVariantMap{{"type", "Interrupt"}};
-    }
-    else if (method == "Debugger.resume") {
-        v4CommandRef = QVariantMap{{"type", "Continue"}};
-    }
-    else if (method == "Debugger.stepInto") {
-        v4CommandRef = QVariantMap{{"type", "StepInto"}};
-    }
-    else if (method == "Debugger.stepOver") {
-        v4CommandRef = QVariantMap{{"type", "StepOver"}};
-    }
-    else if (method == "Debugger.stepOut") {
-        v4CommandRef = QVariantMap{{"type", "StepOut"}};
-    }
-
-    // --------------------
-    // Breakpoints
-    // --------------------
-    else if (method == "Debugger.setBreakpointByUrl") {
-        QVariantMap bpData{
-            {"fileName", normalizeScriptName(params.value("url").toString())},
-            {"lineNumber", params.value("lineNumber")},
-            {"condtion", params.value("condition")},
-            {"enabled", true} // we assume breakpoints are always enabled when set
-        };
-        QVariantMap attributes;
-        attributes["breakpointData"] = bpData;
-        v4CommandRef = QVariantMap{{"type", "SetBreakpoint"}, {"attributes", attributes}};
-    }
-    else if (method == "Debugger.removeBreakpoint") {
-        QVariantMap attributes{
-            {"breakpointId", params.value("breakpointId")}
-        };
-        v4CommandRef = QVariantMap{{"type", "DeleteBreakpoint"}, {"attributes", attributes}};
-    }
-    else if (method == "Debugger.getPossibleBreakpoints") {
-        v4CommandRef = QVariantMap{{"type", "GetBreakpoints"}};
-    }
-
-    // --------------------
-    // Script / Source
-    // --------------------
-    else if (method == "Debugger.getScriptSource") {
-        QVariantMap attributes{
-            {"scriptId", params.value("scriptId")}
-        };
-        v4CommandRef = QVariantMap{{"type", "GetScriptData"}, {"attributes", attributes}};
-    }
-
-    // --------------------
-    // Stack
-    // --------------------
-    else if (method == "Debugger.getStackTrace") {
-        v4CommandRef = QVariantMap{{"type", "GetBacktrace"}};
-    }
-
-    // --------------------
-    // Debugger Setup / Configuration -- no real backend mapping needed as they are not supported by V4
-    // --------------------
-    else if (method == "Debugger.setPauseOnExceptions" ||
-             method == "Debugger.setAsyncCallStackDepth" ||
-             method == "Debugger.setBlackboxPatterns") {
-        createNoOpCdpToV4(v4Request, cdpRequest);
-    }
-
-    else if (method == "Debugger.evaluateOnCallFrame") {
-        v4Request = mapCdpToV4Request_helper_evaluate(method, cdpRequest);
-    }
-
-    else {
-        // Not handled by this module
-        v4Request.clear();
-        return v4Request; // return here so no MAPPER_METADATA can be set
-    }
-
-    cdpRequest[MAPPER_METADATA] = V4CdpMapper::Modules::Debugger;
-
-    return v4Request;
-}
-
-//
-// V4 -> CDP (Debugger.*)
-//
-QVariantMap V4CdpMapper::mapV4ToCdpResponse_debugger(const QVariantMap& v4Response, const QVariantMap& origCdpRequest)
-{
-    QVariantMap cdpResponse;
-    QString method = origCdpRequest.value("method").toString();
-    QVariantMap result;
-
-    cdpResponse["id"] = v4Response.value("ID");
-    QVariantMap v4Result = v4Response.value("Result").toMap();
-
-    // Debugger.getScriptSource
-    if (method == "Debugger.getScriptSource") {
-        result["scriptSource"] = V4Helpers::getNestedValue(v4Response, {"Result", "result", "contents"});
-        cdpResponse["result"] = result;
-    }
-    else if (method == "Debugger.removeBreakpoint") {
-        cdpResponse["result"] = QVariantMap(); // empty result
-    }
-    // Breakpoint Mapping
-    else if (method == "Debugger.setBreakpointByUrl") {
-        bool isValidId;
-        int scriptId = V4Helpers::getNestedValue(v4Response, {"Result", "result"}).toInt(&isValidId);
-
-        if (isValidId) {
-            result["breakpointId"] = QString::number(scriptId);
-            cdpResponse["result"] = result;
-        } else {
-            QString unknownScript = V4Helpers::getNestedValue(origCdpRequest, {"params", "url"}).toString();
-            // Failed to set breakpoint
-            cdpResponse["error"] = QVariantMap{
-                {"code", -32000},
-                {"message", QString("No script matching %1").arg(unknownScript)}
-            };
-        }
-    }
-    // Stacktrace Mapping
-    else if (method == "Debugger.getStackTrace") {
-       cdpResponse = mapV4ToCdpResponse_helper_stack(v4Response, origCdpRequest);
-
-    } else if (method == "Debugger.getPossibleBreakpoints") {
-        // V4 Result is likely a list of breakpoints
-        QVariantList v4List = V4Helpers::getNestedValue(v4Response, {"Result", "result"}).toList();
-        QVariantList outList;
-        for (const QVariant &b : v4List) {
-            QVariantMap bm = b.toMap();
-            QVariantMap e;
-            e["lineNumber"] = bm.value("lineNumber");
-            e["scriptId"] = bm.value("scriptId");
-            outList.append(e);
-        }
-        cdpResponse["result"] = QVariantMap{{"locations", outList}};
-    }
-
-    else if (method == "Debugger.evaluateOnCallFrame") {
-        QVariantMap res = v4Response.value("Result").toMap();
-        // Expecting object handle
-        QVariantMap out;
-        if (v4Result.contains("type") && v4Result.value("type").toString() == "ObjectValue") {
-            out["result"] = QVariantMap{{"type", "object"}, {"objectId", v4Result.value("value")}};
-        } else {
-            out["result"] = v4Result;
-        }
-        cdpResponse["result"] = out;
-    }
-
-    // no real backend mapping needed as they are not supported by V4
-    else if (method == "Debugger.setPauseOnExceptions" ||
-             method == "Debugger.setAsyncCallStackDepth" ||
-             method == "Debugger.setBlackboxPatterns") {
-        // No-Op passthrough
-        cdpResponse["result"] = QVariantMap{};
-    }
-
-    // Default passthrough
-    else {
-        cdpResponse["result"] = v4Result;
-    }
-
-    return cdpResponse;
-}
-
-//
-// CDP -> V4 (Runtime.*)
-//
-QVariantMap V4CdpMapper::mapCdpToV4Request_runtime(QVariantMap& cdpRequest)
-{
-    QVariantMap v4Request;
-    v4Request["ID"] = cdpRequest.value("id");
-    QVariant &v4CommandRef = v4Request["Command"];
-    QString method = cdpRequest.value("method").toString();
-    QVariantMap params = cdpRequest.value("params").toMap();
-
-    //v4Request["handled"] = false;
-
-    // Runtime.evaluate
-    if (method == "Runtime.evaluate") {
-        v4Request = mapCdpToV4Request_helper_evaluate(method, cdpRequest);
-    }
-
-    // Runtime.getProperties
-    else if (method == "Runtime.getProperties") {
-        QVariantMap attributes{
-            {"iteratorId", params.value("objectId")}
-        };
-        v4CommandRef = QVariantMap{{"type", "GetPropertiesByIterator"}, {"attributes", attributes}};
-    }
-
-    // Runtime.callFunctionOn
-    else if (method == "Runtime.callFunctionOn") {
-        QVariantMap attributes{
-            {"scriptValue", QVariantMap{{"type", "ObjectValue" }, {"value", params.value("functionDeclaration")}} }
-        };
-        v4CommandRef = QVariantMap{{"type", "ScriptValueToString"}, {"attributes", attributes}};
-    }
-
-    // no real backend mapping needed as they are not supported by V4
-    else if (method == "Runtime.addBinding" ||
-             method == "Runtime.removeBinding" ||
-             method == "Runtime.releaseObject" ||
-             method == "Runtime.releaseObjectGroup" ||
-             method == "Runtime.getHeapUsage" ||
-             method == "Runtime.awaitPromise") {
-        createNoOpCdpToV4(v4Request, cdpRequest);
-    }
-    else {
-        // Not handled by this module
-        v4Request.clear();
-        return v4Request; // return here so no MAPPER_METADATA can be set
-    }
-
-    cdpRequest[MAPPER_METADATA] = V4CdpMapper::Modules::Runtime;
-
-    return v4Request;
-}
-
-//
-// V4 -> CDP (Runtime.*)
-//
-QVariantMap V4CdpMapper::mapV4ToCdpResponse_runtime(const QVariantMap& v4Response, const QVariantMap& origCdpRequest)
-{
-    QVariantMap cdpResponse;
-    QString method = origCdpRequest.value("method").toString();
-    QVariantMap result;
-
-    cdpResponse["id"] = v4Response.value("ID");
-    cdpResponse["_mapper_metadata"] = origCdpRequest.value("_mapper_metadata");
-
-    if (method == "Runtime.evaluate") {
-        result["result"] = QVariantMap{
-            {"type", "string"},
-            {"value", v4Response.value("Result")}
-        };
-        cdpResponse["result"] = result;
-    }
-    else if (method == "Runtime.getProperties") {
-        result["result"] = v4Response.value("Result").toList();
-        cdpResponse["result"] = result;
-    }
-    else if (method == "Runtime.callFunctionOn") {
-        cdpResponse["result"] = v4Response.value("Result"); // TODO not implemented in backend
-    }
-    // no real backend mapping needed as they are not supported by V4
-    else if (method == "Runtime.addBinding" ||
-             method == "Runtime.removeBinding" ||
-             method == "Runtime.releaseObject" ||
-             method == "Runtime.releaseObjectGroup" ||
-             method == "Runtime.getHeapUsage" ||
-             method == "Runtime.awaitPromise") {
-        // No-Op passthrough
-        cdpResponse["result"] = QVariantMap{};
-    }
-    else {
-        cdpResponse["result"] = v4Response.value("Result");
-    }
-
-    return cdpResponse;
-}
@@ -5,18 +5,29 @@ QVariant V4Helpers::getNestedValue(
     std::initializer_list<QString> path,
     const QVariant &defaultValue)
 {
-    QVariant current = map; // no address, just copy it
+    // walk the nested maps by reference, only the value found is copied
+    const QVariantMap *inner = &map;
+    const QVariant *current = nullptr;
+    QVariantMap converted; // holds a level which is not stored as a QVariantMap
 
     for (const QString &key : path) {
-        if (!current.canConvert<QVariantMap>())
-            return defaultValue;
+        if (current) {
+            if (current->metaType() == QMetaType::fromType<QVariantMap>())
+                inner = static_cast<const QVariantMap*>(current->constData());
+            else if (current->canConvert<QVariantMap>()) {
+                converted = current->toMap();
+                inner = &converted;
+            }
+            else
+                return defaultValue;
+        }
 
-        const QVariantMap inner = current.toMap();
-        if (!inner.contains(key))
+        auto it = inner->constFind(key);
+        if (it == inner->constEnd())
             return defaultValue;
 
-        current = inner.value(key);
+        current = &it.value();
     }
 
-    return current;
+    return current ? *current : QVariant(map);
 }